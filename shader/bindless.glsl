@@ -0,0 +1,19 @@
+// Bindless resource table (src/BindlessTable.h), set 1, one array per resource kind.
+// Include after #extension GL_EXT_nonuniform_qualifier : require and index with
+// the handles pushed per draw; wrap in nonuniformEXT() when a handle varies per invocation.
+// Not compiled by itself (no stage suffix), see triangle.bindless.frag.glsl.
+
+layout(set = 1, binding = 0) uniform texture2D bindlessImages[];
+layout(set = 1, binding = 1) uniform sampler bindlessSamplers[];
+layout(set = 1, binding = 2) buffer BindlessBuffer {
+    uint words[];
+} bindlessBuffers[];
+
+// BindlessTable::Handles
+layout(push_constant) uniform BindlessHandles {
+    uint image;
+    uint sampler;
+    uint buffer;
+} handles;
+
+const uint invalidHandle = 0xFFFFFFFFu;
@@ -0,0 +1,36 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+
+// One VkDrawIndirectCommand per entry of the draw list (same layout as DrawCmd in Scene.h).
+// Culled draws keep their slot with instanceCount 0, so bucket ranges stay valid.
+struct DrawCmd {
+    uint vertexCnt;
+    uint instanceCnt;
+    uint firstVertex;
+    uint firstInstance;
+};
+
+layout(local_size_x = 64) in;
+
+layout(std430, set = 0, binding = 0) readonly buffer Draws {
+    DrawCmd draws[];
+};
+layout(std430, set = 0, binding = 1) writeonly buffer IndirectCmds {
+    DrawCmd cmds[];
+};
+layout(push_constant) uniform Params {
+    uint drawCnt;
+} params;
+
+void main() {
+    uint i = gl_GlobalInvocationID.x;
+    if (i >= params.drawCnt) {
+        return;
+    }
+    DrawCmd d = draws[i];
+    // draws carry no bounds yet: only empty draws are culled
+    if (d.vertexCnt == 0) {
+        d.instanceCnt = 0;
+    }
+    cmds[i] = d;
+}
@@ -0,0 +1,9 @@
+#version 450
+#extension GL_ARB_separate_shader_objects : enable
+#extension GL_GOOGLE_include_directive : require
+#extension GL_EXT_nonuniform_qualifier : require
+
+// used instead of triangle.frag when the device has the bindless table (set 1)
+#define BINDLESS
+#include "bindless.glsl"
+#include "triangle_frag.glsl"
@@ -5,21 +5,27 @@ out gl_PerVertex {
     vec4 gl_Position;
 };
 
-layout(location = 0) out vec3 fragColor;
+// frame arena, bound with a dynamic offset (FrameUniforms in Vulkan.h)
+layout(set = 0, binding = 0) uniform FrameUniforms {
+    vec4 rotation;
+    float time;
+    float hue;
+} frame;
+
+// specialization constants, TriangleConstant in Vulkan.h
+layout(constant_id = 0) const bool rotate = true;
 
-vec2 positions[3] = vec2[](
-    vec2(0.0, -0.5),
-    vec2(0.5, 0.5),
-    vec2(-0.5, 0.5)
-);
+// Vertex in Vulkan.h
+layout(location = 0) in vec2 inPosition;
+layout(location = 1) in vec3 inColor;
 
-vec3 colors[3] = vec3[](
-    vec3(1.0, 0.0, 0.0),
-    vec3(0.0, 1.0, 0.0),
-    vec3(0.0, 0.0, 1.0)
-);
+layout(location = 0) out vec3 fragColor;
 
 void main() {
-    gl_Position = vec4(positions[gl_VertexIndex], 0.0, 1.0);
-    fragColor = colors[gl_VertexIndex];
+    vec2 p = inPosition;
+    if (rotate) {
+        p = vec2(dot(frame.rotation.xy, p), dot(frame.rotation.zw, p));
+    }
+    gl_Position = vec4(p, 0.0, 1.0);
+    fragColor = inColor;
 }
@@ -0,0 +1,32 @@
+// Body of the triangle fragment shader, included by triangle.frag.glsl and
+// (with BINDLESS defined, after bindless.glsl) by triangle.bindless.frag.glsl.
+// Not compiled by itself (no stage suffix).
+
+// frame arena, bound with a dynamic offset (FrameUniforms in Vulkan.h)
+layout(set = 0, binding = 0) uniform FrameUniforms {
+    vec4 rotation;
+    float time;
+    float hue;
+} frame;
+
+// specialization constants, TriangleConstant in Vulkan.h
+layout(constant_id = 1) const bool hueTint = false;
+
+layout(location = 0) in vec3 fragColor;
+layout(location = 0) out vec4 outColor;
+
+void main() {
+    vec3 color = fragColor;
+    if (hueTint) {
+        vec3 tint = clamp(abs(mod(frame.hue * 6.0 + vec3(0.0, 4.0, 2.0), 6.0) - 3.0) - 1.0, 0.0, 1.0);
+        color = mix(color, tint, 0.5);
+    }
+#ifdef BINDLESS
+    // material of the draw: rgb scale as floats, see Vulkan::createMaterialBuffer
+    if (handles.buffer != invalidHandle) {
+        uint b = handles.buffer;
+        color *= uintBitsToFloat(uvec3(bindlessBuffers[b].words[0], bindlessBuffers[b].words[1], bindlessBuffers[b].words[2]));
+    }
+#endif
+    outColor = vec4(color, 1.0);
+}
@@ -0,0 +1,353 @@
+#ifndef ASYNCCOMPUTE_H
+#define ASYNCCOMPUTE_H
+
+#include <vulkan/vulkan.h>
+#include <array>
+#include <span>
+#include <vector>
+#include <algorithm>
+#include <cstring>
+#include <format>
+#include <exception>
+#include "Scene.h"
+#include "GpuAllocator.h"
+
+// Culling pass on the compute queue, overlapping with graphics of the previous frame.
+// Per frame in flight: the draw list is mirrored into a host-visible input buffer,
+// cull.comp writes one VkDrawIndirectCommand per draw into a device-local output
+// buffer, and graphics draws from it with vkCmdDrawIndirect after waiting on done(frame).
+// Compute and graphics of different families: the output buffer is released by
+// compute and acquired by graphics (queue family ownership transfer). One family
+// (e.g. lavapipe): barriers are skipped, the semaphore alone orders the two submissions.
+class AsyncCompute
+{
+public:
+    inline void init (VkDevice device, uint32_t computeFamily, uint32_t graphicsFamily, uint32_t frameCnt,
+        std::span<const char> cullSpirv, GpuAllocator& allocator, VkPipelineCache pipelineCache)
+    {
+        this->computeFamily = computeFamily;
+        this->graphicsFamily = graphicsFamily;
+        this->allocator = &allocator;
+    // Step 1: Pipeline: 2 storage buffers (draws in, indirect commands out), draw count as push constant
+        {
+            std::array<VkDescriptorSetLayoutBinding, 2> bindings;
+            for (uint32_t i = 0; i < bindings.size(); ++i) {
+                auto& b = bindings[i];
+                b.binding = i;
+                b.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+                b.descriptorCount = 1;
+                b.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+                b.pImmutableSamplers = nullptr;
+            }
+            VkDescriptorSetLayoutCreateInfo descriptorSetLayoutCreateInfo;
+            auto& ci = descriptorSetLayoutCreateInfo;
+            ci.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+            ci.pNext = nullptr;
+            ci.flags = 0;
+            ci.bindingCount = bindings.size();
+            ci.pBindings = bindings.data();
+            VkResult r = vkCreateDescriptorSetLayout(device, &ci, nullptr, &descriptorSetLayout);
+            if (r != VK_SUCCESS) throw std::runtime_error(std::format("vkCreateDescriptorSetLayout: {}", (int)r));
+        }
+        {
+            VkPushConstantRange pushConstantRange;
+            pushConstantRange.stageFlags = VK_SHADER_STAGE_COMPUTE_BIT;
+            pushConstantRange.offset = 0;
+            pushConstantRange.size = sizeof(uint32_t);
+            VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo;
+            auto& ci = pipelineLayoutCreateInfo;
+            ci.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
+            ci.pNext = nullptr;
+            ci.flags = 0;
+            ci.setLayoutCount = 1;
+            ci.pSetLayouts = &descriptorSetLayout;
+            ci.pushConstantRangeCount = 1;
+            ci.pPushConstantRanges = &pushConstantRange;
+            VkResult r = vkCreatePipelineLayout(device, &ci, nullptr, &pipelineLayout);
+            if (r != VK_SUCCESS) throw std::runtime_error(std::format("vkCreatePipelineLayout: {}", (int)r));
+        }
+        {
+            VkShaderModuleCreateInfo shaderModuleCreateInfo;
+            auto& ci = shaderModuleCreateInfo;
+            ci.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
+            ci.pNext = nullptr;
+            ci.flags = 0;
+            ci.codeSize = cullSpirv.size();
+            ci.pCode = reinterpret_cast<const uint32_t*>(cullSpirv.data());
+            VkResult r = vkCreateShaderModule(device, &ci, nullptr, &shaderModule);
+            if (r != VK_SUCCESS) throw std::runtime_error(std::format("vkCreateShaderModule: {}", (int)r));
+        }
+        {
+            VkComputePipelineCreateInfo computePipelineCreateInfo;
+            auto& ci = computePipelineCreateInfo;
+            ci.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO;
+            ci.pNext = nullptr;
+            ci.flags = 0;
+            ci.stage.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+            ci.stage.pNext = nullptr;
+            ci.stage.flags = 0;
+            ci.stage.stage = VK_SHADER_STAGE_COMPUTE_BIT;
+            ci.stage.module = shaderModule;
+            ci.stage.pName = "main";
+            ci.stage.pSpecializationInfo = nullptr;
+            ci.layout = pipelineLayout;
+            ci.basePipelineHandle = VK_NULL_HANDLE;
+            ci.basePipelineIndex = -1;
+            VkResult r = vkCreateComputePipelines(device, pipelineCache, 1, &ci, nullptr, &pipeline);
+            if (r != VK_SUCCESS) throw std::runtime_error(std::format("vkCreateComputePipelines: {}", (int)r));
+        }
+    // Step 2: One descriptor set per frame, written whenever that frame's buffers are (re)created
+        {
+            VkDescriptorPoolSize poolSize;
+            poolSize.type = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+            poolSize.descriptorCount = 2 * frameCnt;
+            VkDescriptorPoolCreateInfo descriptorPoolCreateInfo;
+            auto& ci = descriptorPoolCreateInfo;
+            ci.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+            ci.pNext = nullptr;
+            ci.flags = 0;
+            ci.maxSets = frameCnt;
+            ci.poolSizeCount = 1;
+            ci.pPoolSizes = &poolSize;
+            VkResult r = vkCreateDescriptorPool(device, &ci, nullptr, &descriptorPool);
+            if (r != VK_SUCCESS) throw std::runtime_error(std::format("vkCreateDescriptorPool: {}", (int)r));
+        }
+    // Step 3: Per-frame command buffer (compute family) and completion semaphore
+        frames.resize(frameCnt);
+        for (auto& f : frames) {
+            VkCommandPoolCreateInfo commandPoolCreateInfo;
+            {
+                auto& ci = commandPoolCreateInfo;
+                ci.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+                ci.pNext = nullptr;
+                ci.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+                ci.queueFamilyIndex = computeFamily;
+            }
+            VkResult r = vkCreateCommandPool(device, &commandPoolCreateInfo, nullptr, &(f.commandPool));
+            if (r != VK_SUCCESS) throw std::runtime_error(std::format("vkCreateCommandPool: {}", (int)r));
+            VkCommandBufferAllocateInfo commandBufferAllocateInfo;
+            {
+                auto& ai = commandBufferAllocateInfo;
+                ai.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+                ai.pNext = nullptr;
+                ai.commandPool = f.commandPool;
+                ai.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+                ai.commandBufferCount = 1;
+            }
+            r = vkAllocateCommandBuffers(device, &commandBufferAllocateInfo, &(f.commandBuffer));
+            if (r != VK_SUCCESS) throw std::runtime_error(std::format("vkAllocateCommandBuffers: {}", (int)r));
+            VkSemaphoreCreateInfo semaphoreCreateInfo;
+            {
+                auto& ci = semaphoreCreateInfo;
+                ci.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+                ci.pNext = nullptr;
+                ci.flags = 0;
+            }
+            r = vkCreateSemaphore(device, &semaphoreCreateInfo, nullptr, &(f.done));
+            if (r != VK_SUCCESS) throw std::runtime_error(std::format("vkCreateSemaphore: {}", (int)r));
+            VkDescriptorSetAllocateInfo descriptorSetAllocateInfo;
+            {
+                auto& ai = descriptorSetAllocateInfo;
+                ai.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+                ai.pNext = nullptr;
+                ai.descriptorPool = descriptorPool;
+                ai.descriptorSetCount = 1;
+                ai.pSetLayouts = &descriptorSetLayout;
+            }
+            r = vkAllocateDescriptorSets(device, &descriptorSetAllocateInfo, &(f.descriptorSet));
+            if (r != VK_SUCCESS) throw std::runtime_error(std::format("vkAllocateDescriptorSets: {}", (int)r));
+        }
+    }
+    inline void destroy (VkDevice device)
+    {
+        for (auto& f : frames) {
+            destroyBuffers(f);
+            vkDestroySemaphore(device, f.done, nullptr);
+            vkDestroyCommandPool(device, f.commandPool, nullptr);
+        }
+        frames.clear();
+        vkDestroyDescriptorPool(device, descriptorPool, nullptr);
+        vkDestroyPipeline(device, pipeline, nullptr);
+        vkDestroyShaderModule(device, shaderModule, nullptr);
+        vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
+        vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
+    }
+
+// Render thread, after the frame's fence has signaled: mirror drawList into the frame's
+// input buffer if it changed since (version), growing the frame's buffers when too small
+    inline void upload (VkDevice device, uint32_t frame, const std::vector<DrawCmd>& drawList, uint64_t version)
+    {
+        auto& f = frames[frame];
+        if (f.version == version && f.input != VK_NULL_HANDLE) return;
+        if (drawList.size() > f.capacity || f.input == VK_NULL_HANDLE) {
+            destroyBuffers(f);
+            createBuffers(device, f, std::max<size_t>(64, drawList.size() + drawList.size() / 2));
+        }
+        std::memcpy(f.inputAllocation.mapped, drawList.data(), drawList.size() * sizeof(DrawCmd));
+        f.version = version;
+    }
+// Records and submits the frame's cull pass, signals done(frame); host writes of
+// upload() are made visible by the submission itself
+    inline void submit (VkDevice device, VkQueue queue, uint32_t frame, uint32_t drawCnt)
+    {
+        auto& f = frames[frame];
+        vkResetCommandPool(device, f.commandPool, 0);
+        VkCommandBufferBeginInfo commandBufferBeginInfo;
+        {
+            auto& ci = commandBufferBeginInfo;
+            ci.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+            ci.pNext = nullptr;
+            ci.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+            ci.pInheritanceInfo = nullptr;
+        }
+        vkBeginCommandBuffer(f.commandBuffer, &commandBufferBeginInfo);
+        if (drawCnt > 0) {
+            vkCmdBindPipeline(f.commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipeline);
+            vkCmdBindDescriptorSets(f.commandBuffer, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, 1, &(f.descriptorSet), 0, nullptr);
+            vkCmdPushConstants(f.commandBuffer, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(uint32_t), &drawCnt);
+            vkCmdDispatch(f.commandBuffer, (drawCnt + 63) / 64, 1, 1);
+        }
+        // release half of the ownership transfer, acquire() is the other half
+        if (computeFamily != graphicsFamily) {
+            VkBufferMemoryBarrier barrier = ownershipBarrier(f, VK_ACCESS_SHADER_WRITE_BIT, 0);
+            vkCmdPipelineBarrier(f.commandBuffer, VK_PIPELINE_STAGE_COMPUTE_SHADER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+                0, 0, nullptr, 1, &barrier, 0, nullptr);
+        }
+        VkResult r = vkEndCommandBuffer(f.commandBuffer);
+        if (r != VK_SUCCESS) throw std::runtime_error(std::format("vkEndCommandBuffer: {}", (int)r));
+        VkSubmitInfo submitInfo;
+        {
+            auto& si = submitInfo;
+            si.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+            si.pNext = nullptr;
+            si.waitSemaphoreCount = 0;
+            si.pWaitSemaphores = nullptr;
+            si.pWaitDstStageMask = nullptr;
+            si.commandBufferCount = 1;
+            si.pCommandBuffers = &(f.commandBuffer);
+            si.signalSemaphoreCount = 1;
+            si.pSignalSemaphores = &(f.done);
+        }
+        // no fence: the graphics submission waits on done and its fence covers both
+        r = vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE);
+        if (r != VK_SUCCESS) throw std::runtime_error(std::format("vkQueueSubmit: {}", (int)r));
+    }
+// Graphics primary, outside the render pass: acquire the frame's indirect commands
+    inline void acquire (VkCommandBuffer cb, uint32_t frame)
+    {
+        if (computeFamily == graphicsFamily) return;
+        VkBufferMemoryBarrier barrier = ownershipBarrier(frames[frame], 0, VK_ACCESS_INDIRECT_COMMAND_READ_BIT);
+        vkCmdPipelineBarrier(cb, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT,
+            0, 0, nullptr, 1, &barrier, 0, nullptr);
+    }
+
+    inline VkBuffer indirectBuffer (uint32_t frame) const
+    {
+        return frames[frame].output;
+    }
+    inline VkSemaphore done (uint32_t frame) const
+    {
+        return frames[frame].done;
+    }
+// bumped whenever buffers are recreated: secondaries recorded against the old ones are stale
+    inline uint64_t generation () const
+    {
+        return bufferGeneration;
+    }
+
+private:
+    struct Frame {
+        VkCommandPool commandPool = VK_NULL_HANDLE;
+        VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+        VkSemaphore done = VK_NULL_HANDLE;
+        VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+        VkBuffer input = VK_NULL_HANDLE;
+        GpuAllocation inputAllocation;
+        VkBuffer output = VK_NULL_HANDLE;
+        GpuAllocation outputAllocation;
+    // in draws
+        size_t capacity = 0;
+        uint64_t version = 0;
+    };
+    std::vector<Frame> frames;
+    uint32_t computeFamily = 0;
+    uint32_t graphicsFamily = 0;
+    GpuAllocator* allocator = nullptr;
+    VkDescriptorSetLayout descriptorSetLayout = VK_NULL_HANDLE;
+    VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+    VkShaderModule shaderModule = VK_NULL_HANDLE;
+    VkPipeline pipeline = VK_NULL_HANDLE;
+    VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+    uint64_t bufferGeneration = 0;
+
+    inline VkBufferMemoryBarrier ownershipBarrier (const Frame& f, VkAccessFlags srcAccess, VkAccessFlags dstAccess)
+    {
+        VkBufferMemoryBarrier barrier;
+        barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+        barrier.pNext = nullptr;
+        barrier.srcAccessMask = srcAccess;
+        barrier.dstAccessMask = dstAccess;
+        barrier.srcQueueFamilyIndex = computeFamily;
+        barrier.dstQueueFamilyIndex = graphicsFamily;
+        barrier.buffer = f.output;
+        barrier.offset = 0;
+        barrier.size = VK_WHOLE_SIZE;
+        return barrier;
+    }
+    inline VkBuffer createBuffer (VkDeviceSize size, VkBufferUsageFlags usage, MemoryUsage memoryUsage, GpuAllocation& allocation)
+    {
+        VkBufferCreateInfo bufferCreateInfo;
+        auto& ci = bufferCreateInfo;
+        ci.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+        ci.pNext = nullptr;
+        ci.flags = 0;
+        ci.size = size;
+        ci.usage = usage;
+    // owned by one family at a time, handed over with ownership barriers
+        ci.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        ci.queueFamilyIndexCount = 0;
+        ci.pQueueFamilyIndices = nullptr;
+        return allocator->createBuffer(ci, memoryUsage, allocation);
+    }
+    inline void createBuffers (VkDevice device, Frame& f, size_t capacity)
+    {
+        VkDeviceSize size = capacity * sizeof(DrawCmd);
+        // persistently mapped, written by upload() only while the frame is idle
+        f.input = createBuffer(size, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT, MemoryUsage::Dynamic, f.inputAllocation);
+        f.output = createBuffer(size, VK_BUFFER_USAGE_STORAGE_BUFFER_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT,
+            MemoryUsage::GpuOnly, f.outputAllocation);
+        f.capacity = capacity;
+        ++bufferGeneration;
+
+        std::array<VkDescriptorBufferInfo, 2> bufferInfos = {{
+            { f.input, 0, VK_WHOLE_SIZE },
+            { f.output, 0, VK_WHOLE_SIZE }
+        }};
+        std::array<VkWriteDescriptorSet, 2> writes;
+        for (uint32_t i = 0; i < writes.size(); ++i) {
+            auto& w = writes[i];
+            w.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+            w.pNext = nullptr;
+            w.dstSet = f.descriptorSet;
+            w.dstBinding = i;
+            w.dstArrayElement = 0;
+            w.descriptorCount = 1;
+            w.descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_BUFFER;
+            w.pImageInfo = nullptr;
+            w.pBufferInfo = &(bufferInfos[i]);
+            w.pTexelBufferView = nullptr;
+        }
+        vkUpdateDescriptorSets(device, writes.size(), writes.data(), 0, nullptr);
+    }
+    inline void destroyBuffers (Frame& f)
+    {
+        if (f.input == VK_NULL_HANDLE) return;
+        allocator->destroyBuffer(f.input, f.inputAllocation);
+        allocator->destroyBuffer(f.output, f.outputAllocation);
+        f.input = VK_NULL_HANDLE;
+        f.output = VK_NULL_HANDLE;
+        f.capacity = 0;
+    }
+};
+
+#endif
@@ -0,0 +1,124 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <format>
+#include <exception>
+#include <sys/resource.h>
+#include "utils.h"
+#include "Config.h"
+#include "Telemetry.h"
+#include "Vulkan.h"
+
+// --bench: fixed warmup + measured frames instead of the interactive loop,
+// results printed as JSON so runs of different builds can be diffed
+struct BenchOptions
+{
+    bool enabled = false;
+    size_t warmupFrames = 100;
+    size_t measuredFrames = 1000;
+// empty means stdout, which carries nothing else (logs go to stderr)
+    std::string outPath;
+};
+
+// JSON string contents: quotes, backslashes and control characters escaped
+inline std::string jsonEscape (const std::string& s)
+{
+    std::string out;
+    out.reserve(s.size());
+    for (char c : s) {
+        if (c == '"' || c == '\\') {
+            out += '\\';
+            out += c;
+        } else if (static_cast<unsigned char>(c) < 0x20) {
+            out += std::format("\\u{:04x}", static_cast<unsigned>(c));
+        } else {
+            out += c;
+        }
+    }
+    return out;
+}
+
+inline size_t peakRssKb ()
+{
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+    // bytes on macOS, kilobytes elsewhere
+    return usage.ru_maxrss / 1024;
+#else
+    return usage.ru_maxrss;
+#endif
+}
+
+template <typename Ctx>
+void runBench (Config& cfg, BenchOptions& opt, std::chrono::steady_clock::time_point processStartTime)
+{
+    Ctx ctx(cfg);
+// startup includes pipeline compilation, which otherwise finishes in the background
+    ctx.getVulkan().waitPipelines();
+    auto startupNs = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - processStartTime).count();
+    Vulkan& vk = ctx.getVulkan();
+    Telemetry& telemetry = vk.getTelemetry();
+
+    logInfo(std::format("Bench: scene {}, {} warmup + {} measured frames", cfg.scene, opt.warmupFrames, opt.measuredFrames));
+    for (size_t i = 0; i < opt.warmupFrames && ctx.running; ++i) {
+        ctx.eventLoop();
+        ctx.render();
+    }
+    uint64_t firstFrame = telemetry.frameCount();
+    auto measureStartTime = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < opt.measuredFrames && ctx.running; ++i) {
+        ctx.eventLoop();
+        ctx.render();
+    }
+    auto wallNs = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - measureStartTime).count();
+    uint64_t measured = telemetry.frameCount() - firstFrame;
+
+    std::ostringstream json;
+    json << "{\n";
+    json << std::format("  \"scene\": \"{}\",\n", jsonEscape(cfg.scene));
+    json << std::format("  \"headless\": {},\n", cfg.headless ? "true" : "false");
+    json << std::format("  \"device\": \"{}\",\n", jsonEscape(vk.getDeviceName()));
+    json << std::format("  \"presentMode\": \"{}\",\n", jsonEscape(cfg.presentMode));
+    json << std::format("  \"warmupFrames\": {},\n", opt.warmupFrames);
+    json << std::format("  \"measuredFrames\": {},\n", measured);
+    json << std::format("  \"sampledFrames\": {},\n", std::min<uint64_t>(measured, Telemetry::capacity));
+    json << std::format("  \"startupMs\": {:.3f},\n", startupNs / 1e6);
+    json << "  \"initPhasesMs\": {";
+    {
+        auto& phases = vk.getInitPhases();
+        for (size_t i = 0; i < phases.size(); ++i) {
+            json << std::format("{}\n    \"{}\": {:.3f}", i == 0 ? "" : ",", jsonEscape(phases[i].first), phases[i].second / 1e6);
+        }
+    }
+    json << "\n  },\n";
+    json << "  \"frameTimesMs\": {";
+    for (uint32_t m = 0; m < Telemetry::MetricCount; ++m) {
+        Telemetry::Summary s = telemetry.summarize(static_cast<Telemetry::Metric>(m), firstFrame);
+        json << std::format("{}\n    \"{}\": {{ \"p50\": {:.4f}, \"p95\": {:.4f}, \"p99\": {:.4f}, \"max\": {:.4f} }}",
+            m == 0 ? "" : ",", Telemetry::metricNames[m], s.p50 / 1e6, s.p95 / 1e6, s.p99 / 1e6, s.max / 1e6);
+    }
+    json << "\n  },\n";
+    json << std::format("  \"wallTimeMs\": {:.3f},\n", wallNs / 1e6);
+    json << std::format("  \"fps\": {:.2f},\n", wallNs > 0 ? measured * 1e9 / wallNs : 0.0);
+    json << std::format("  \"peakRssKb\": {}\n", peakRssKb());
+    json << "}\n";
+
+    if (opt.outPath.empty()) {
+        std::cout << json.str() << std::flush;
+    } else {
+        std::ofstream out(opt.outPath, std::ios::out | std::ios::trunc);
+        if (!out.is_open()) {
+            throw std::runtime_error(std::format("could not open bench output at {}", opt.outPath));
+        }
+        out << json.str();
+        logInfo(std::format("Bench results written to {}", opt.outPath));
+    }
+}
+
+#endif
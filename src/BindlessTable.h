@@ -0,0 +1,264 @@
+#ifndef BINDLESSTABLE_H
+#define BINDLESSTABLE_H
+
+#include <vulkan/vulkan.h>
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+#include <format>
+#include <exception>
+
+// Global bindless resource table (descriptor indexing, core in 1.2).
+//
+// One descriptor set with one large array per resource kind, partially bound and
+// update-after-bind, bound once per command buffer. Resources are registered once
+// and addressed by 32-bit handles (array indices) that shaders get through push
+// constants (Handles below, layout in shader/bindless.glsl), so switching
+// textures / materials per draw is a vkCmdPushConstants, never a descriptor bind.
+// Registering writes the descriptor right away: UPDATE_UNUSED_WHILE_PENDING allows it
+// while frames in flight use other entries of the set. Released handles are reused only
+// once the frame that released them has completed (beginFrame).
+// Thread-safe, except init / destroy / beginFrame (render thread).
+class BindlessTable
+{
+public:
+    using Handle = uint32_t;
+    static constexpr Handle invalidHandle = UINT32_MAX;
+
+    enum Kind : uint32_t {
+        SampledImage = 0,
+        Sampler,
+        StorageBuffer,
+        KindCount
+    };
+
+// push constant block of the graphics pipeline, offset 0
+    struct Handles {
+        Handle image = invalidHandle;
+        Handle sampler = invalidHandle;
+        Handle buffer = invalidHandle;
+        uint32_t pad = 0;
+    };
+
+    BindlessTable () = default;
+    BindlessTable (BindlessTable& rhs) = delete;
+    BindlessTable (BindlessTable&& rhs) = delete;
+
+// Descriptor indexing features the table relies on
+    static inline bool supported (const VkPhysicalDeviceVulkan12Features& f)
+    {
+        return f.descriptorIndexing && f.runtimeDescriptorArray && f.descriptorBindingPartiallyBound
+            && f.descriptorBindingSampledImageUpdateAfterBind && f.descriptorBindingStorageBufferUpdateAfterBind
+            && f.descriptorBindingUpdateUnusedWhilePending;
+    }
+    static inline void enableFeatures (VkPhysicalDeviceVulkan12Features& f)
+    {
+        f.descriptorIndexing = VK_TRUE;
+        f.runtimeDescriptorArray = VK_TRUE;
+        f.descriptorBindingPartiallyBound = VK_TRUE;
+        f.descriptorBindingSampledImageUpdateAfterBind = VK_TRUE;
+        f.descriptorBindingStorageBufferUpdateAfterBind = VK_TRUE;
+        f.descriptorBindingUpdateUnusedWhilePending = VK_TRUE;
+    }
+
+    inline void init (VkPhysicalDevice physicalDevice, VkDevice device, uint32_t frameCnt)
+    {
+        this->device = device;
+        retired.resize(frameCnt);
+    // Step 1: Array sizes, defaults clamped to the update-after-bind limits (per type and per stage)
+        {
+            VkPhysicalDeviceVulkan12Properties vulkan12Properties = {};
+            vulkan12Properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_PROPERTIES;
+            VkPhysicalDeviceProperties2 properties = {};
+            properties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2;
+            properties.pNext = &vulkan12Properties;
+            vkGetPhysicalDeviceProperties2(physicalDevice, &properties);
+            auto& p = vulkan12Properties;
+            capacity[SampledImage] = std::min({defaultCapacity[SampledImage],
+                p.maxPerStageDescriptorUpdateAfterBindSampledImages, p.maxDescriptorSetUpdateAfterBindSampledImages});
+            capacity[Sampler] = std::min({defaultCapacity[Sampler],
+                p.maxPerStageDescriptorUpdateAfterBindSamplers, p.maxDescriptorSetUpdateAfterBindSamplers});
+            capacity[StorageBuffer] = std::min({defaultCapacity[StorageBuffer],
+                p.maxPerStageDescriptorUpdateAfterBindStorageBuffers, p.maxDescriptorSetUpdateAfterBindStorageBuffers});
+        // images and buffers together (samplers do not count) must also fit the per-stage
+        // resource limit, next to set 0 and the attachments of the stages; shrink both alike
+            uint64_t resources = uint64_t(capacity[SampledImage]) + capacity[StorageBuffer];
+            uint64_t budget = p.maxPerStageUpdateAfterBindResources > reservedResources + 2
+                            ? p.maxPerStageUpdateAfterBindResources - reservedResources : 2;
+            if (resources > budget) {
+                capacity[SampledImage] = std::max<uint32_t>(1, capacity[SampledImage] * budget / resources);
+                capacity[StorageBuffer] = std::max<uint32_t>(1, capacity[StorageBuffer] * budget / resources);
+            }
+        }
+    // Step 2: Set layout, binding = Kind
+        {
+            std::array<VkDescriptorSetLayoutBinding, KindCount> bindings;
+            std::array<VkDescriptorBindingFlags, KindCount> bindingFlags;
+            for (uint32_t i = 0; i < KindCount; ++i) {
+                auto& b = bindings[i];
+                b.binding = i;
+                b.descriptorType = descriptorTypes[i];
+                b.descriptorCount = capacity[i];
+                b.stageFlags = VK_SHADER_STAGE_ALL_GRAPHICS | VK_SHADER_STAGE_COMPUTE_BIT;
+                b.pImmutableSamplers = nullptr;
+                bindingFlags[i] = VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT
+                                | VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT
+                                | VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT;
+            }
+            VkDescriptorSetLayoutBindingFlagsCreateInfo bindingFlagsCreateInfo;
+            bindingFlagsCreateInfo.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO;
+            bindingFlagsCreateInfo.pNext = nullptr;
+            bindingFlagsCreateInfo.bindingCount = bindingFlags.size();
+            bindingFlagsCreateInfo.pBindingFlags = bindingFlags.data();
+            VkDescriptorSetLayoutCreateInfo descriptorSetLayoutCreateInfo;
+            auto& ci = descriptorSetLayoutCreateInfo;
+            ci.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+            ci.pNext = &bindingFlagsCreateInfo;
+            ci.flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT;
+            ci.bindingCount = bindings.size();
+            ci.pBindings = bindings.data();
+            VkResult r = vkCreateDescriptorSetLayout(device, &ci, nullptr, &descriptorSetLayout);
+            if (r != VK_SUCCESS) throw std::runtime_error(std::format("vkCreateDescriptorSetLayout: {}", (int)r));
+        }
+    // Step 3: Pool and the one set
+        {
+            std::array<VkDescriptorPoolSize, KindCount> poolSizes;
+            for (uint32_t i = 0; i < KindCount; ++i) {
+                poolSizes[i] = { descriptorTypes[i], capacity[i] };
+            }
+            VkDescriptorPoolCreateInfo descriptorPoolCreateInfo;
+            auto& ci = descriptorPoolCreateInfo;
+            ci.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+            ci.pNext = nullptr;
+            ci.flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT;
+            ci.maxSets = 1;
+            ci.poolSizeCount = poolSizes.size();
+            ci.pPoolSizes = poolSizes.data();
+            VkResult r = vkCreateDescriptorPool(device, &ci, nullptr, &descriptorPool);
+            if (r != VK_SUCCESS) throw std::runtime_error(std::format("vkCreateDescriptorPool: {}", (int)r));
+            VkDescriptorSetAllocateInfo descriptorSetAllocateInfo;
+            auto& ai = descriptorSetAllocateInfo;
+            ai.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+            ai.pNext = nullptr;
+            ai.descriptorPool = descriptorPool;
+            ai.descriptorSetCount = 1;
+            ai.pSetLayouts = &descriptorSetLayout;
+            r = vkAllocateDescriptorSets(device, &ai, &descriptorSet);
+            if (r != VK_SUCCESS) throw std::runtime_error(std::format("vkAllocateDescriptorSets: {}", (int)r));
+        }
+    }
+    inline void destroy ()
+    {
+        if (descriptorPool == VK_NULL_HANDLE) return;
+        // frees descriptorSet too
+        vkDestroyDescriptorPool(device, descriptorPool, nullptr);
+        vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
+        descriptorPool = VK_NULL_HANDLE;
+        descriptorSetLayout = VK_NULL_HANDLE;
+        descriptorSet = VK_NULL_HANDLE;
+    }
+    inline bool enabled () const
+    {
+        return descriptorSet != VK_NULL_HANDLE;
+    }
+
+// Any thread. The view must be in `layout` whenever a shader reads it.
+    inline Handle addImage (VkImageView view, VkImageLayout layout)
+    {
+        VkDescriptorImageInfo info = { VK_NULL_HANDLE, view, layout };
+        return add(SampledImage, &info, nullptr);
+    }
+    inline Handle addSampler (VkSampler sampler)
+    {
+        VkDescriptorImageInfo info = { sampler, VK_NULL_HANDLE, VK_IMAGE_LAYOUT_UNDEFINED };
+        return add(Sampler, &info, nullptr);
+    }
+    inline Handle addBuffer (VkBuffer buffer, VkDeviceSize offset, VkDeviceSize range)
+    {
+        VkDescriptorBufferInfo info = { buffer, offset, range };
+        return add(StorageBuffer, nullptr, &info);
+    }
+// Any thread. The handle must not be used by work recorded after this call;
+// its entry is reused once the current frame has completed.
+    inline void release (Kind kind, Handle handle)
+    {
+        std::lock_guard<std::mutex> lock(m);
+        retired[frame].emplace_back(kind, handle);
+    }
+// Render thread, once the frame's previous submission has completed
+    inline void beginFrame (uint32_t frame)
+    {
+        std::lock_guard<std::mutex> lock(m);
+        this->frame = frame;
+        for (auto [kind, handle] : retired[frame]) {
+            freeHandles[kind].push_back(handle);
+        }
+        retired[frame].clear();
+    }
+    inline uint32_t used (Kind kind)
+    {
+        std::lock_guard<std::mutex> lock(m);
+        return nextHandle[kind] - freeHandles[kind].size();
+    }
+    inline VkDescriptorSetLayout setLayout () const
+    {
+        return descriptorSetLayout;
+    }
+    inline VkDescriptorSet set () const
+    {
+        return descriptorSet;
+    }
+
+private:
+    static constexpr std::array<VkDescriptorType, KindCount> descriptorTypes = {
+        VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, VK_DESCRIPTOR_TYPE_SAMPLER, VK_DESCRIPTOR_TYPE_STORAGE_BUFFER };
+    static constexpr std::array<uint32_t, KindCount> defaultCapacity = { 16384, 256, 8192 };
+// per-stage resources kept for the other sets and the color attachments
+    static constexpr uint32_t reservedResources = 16;
+    static constexpr std::array<const char*, KindCount> kindNames = { "sampled image", "sampler", "storage buffer" };
+
+    VkDevice device = VK_NULL_HANDLE;
+    VkDescriptorSetLayout descriptorSetLayout = VK_NULL_HANDLE;
+    VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+    VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+    std::array<uint32_t, KindCount> capacity = {};
+
+    std::mutex m;
+    std::array<uint32_t, KindCount> nextHandle = {};
+    std::array<std::vector<Handle>, KindCount> freeHandles;
+// per frame in flight: handles released while it was recorded
+    std::vector<std::vector<std::pair<Kind, Handle>>> retired;
+    uint32_t frame = 0;
+
+    inline Handle add (Kind kind, const VkDescriptorImageInfo* imageInfo, const VkDescriptorBufferInfo* bufferInfo)
+    {
+    // the set is externally synchronized, writes stay under the lock too
+        std::lock_guard<std::mutex> lock(m);
+        Handle handle;
+        if (!freeHandles[kind].empty()) {
+            handle = freeHandles[kind].back();
+            freeHandles[kind].pop_back();
+        } else if (nextHandle[kind] < capacity[kind]) {
+            handle = nextHandle[kind]++;
+        } else {
+            throw std::runtime_error(std::format("BindlessTable: all {} {} slots in use", capacity[kind], kindNames[kind]));
+        }
+        VkWriteDescriptorSet write;
+        write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        write.pNext = nullptr;
+        write.dstSet = descriptorSet;
+        write.dstBinding = kind;
+        write.dstArrayElement = handle;
+        write.descriptorCount = 1;
+        write.descriptorType = descriptorTypes[kind];
+        write.pImageInfo = imageInfo;
+        write.pBufferInfo = bufferInfo;
+        write.pTexelBufferView = nullptr;
+        vkUpdateDescriptorSets(device, 1, &write, 0, nullptr);
+        return handle;
+    }
+};
+
+#endif
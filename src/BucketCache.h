@@ -0,0 +1,93 @@
+#ifndef BUCKETCACHE_H
+#define BUCKETCACHE_H
+
+#include <vulkan/vulkan.h>
+#include <array>
+#include <vector>
+#include <format>
+#include <exception>
+#include "Scene.h"
+
+// Prerecorded secondary command buffers, one per (render bucket, frame in flight).
+// Each copy remembers the key it was recorded with (hash of the bucket's draws
+// mixed with the pipeline state they were recorded against); it is re-recorded
+// only when the key changes, so static buckets cost nothing to record per frame.
+// Copies are per frame: re-recording one never touches a buffer still executing
+// in another frame in flight, and no SIMULTANEOUS_USE is needed.
+class BucketCache
+{
+public:
+    inline void init (VkDevice device, uint32_t queueFamilyIndex, uint32_t frameCnt)
+    {
+        this->frameCnt = frameCnt;
+        slots.resize(BucketCount * frameCnt);
+        for (auto& slot : slots) {
+            VkCommandPoolCreateInfo commandPoolCreateInfo;
+            {
+                auto& ci = commandPoolCreateInfo;
+                ci.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+                ci.pNext = nullptr;
+                // one long-lived buffer per pool, reset with the pool before re-recording
+                ci.flags = 0;
+                ci.queueFamilyIndex = queueFamilyIndex;
+            }
+            VkResult r = vkCreateCommandPool(device, &commandPoolCreateInfo, nullptr, &(slot.pool));
+            if (r != VK_SUCCESS) throw std::runtime_error(std::format("vkCreateCommandPool: {}", (int)r));
+            VkCommandBufferAllocateInfo commandBufferAllocateInfo;
+            {
+                auto& ai = commandBufferAllocateInfo;
+                ai.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+                ai.pNext = nullptr;
+                ai.commandPool = slot.pool;
+                ai.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+                ai.commandBufferCount = 1;
+            }
+            r = vkAllocateCommandBuffers(device, &commandBufferAllocateInfo, &(slot.commandBuffer));
+            if (r != VK_SUCCESS) throw std::runtime_error(std::format("vkAllocateCommandBuffers: {}", (int)r));
+        }
+    }
+    inline void destroy (VkDevice device)
+    {
+        for (auto& slot : slots) {
+            vkDestroyCommandPool(device, slot.pool, nullptr);
+        }
+        slots.clear();
+    }
+
+// Render thread, after the frame's fence has signaled. Returns the bucket's buffer
+// reset to initial state if it was recorded with another key, VK_NULL_HANDLE if it is current.
+    inline VkCommandBuffer stale (VkDevice device, RenderBucket bucket, uint32_t frame, uint64_t key)
+    {
+        auto& slot = slots[bucket * frameCnt + frame];
+        if (slot.recorded && slot.key == key) return VK_NULL_HANDLE;
+        vkResetCommandPool(device, slot.pool, 0);
+        slot.key = key;
+        // set before recording: a failed record throws and the device is torn down anyway
+        slot.recorded = true;
+        ++rerecordCnt;
+        return slot.commandBuffer;
+    }
+    inline VkCommandBuffer get (RenderBucket bucket, uint32_t frame) const
+    {
+        return slots[bucket * frameCnt + frame].commandBuffer;
+    }
+// number of bucket re-records so far
+    inline uint64_t rerecords () const
+    {
+        return rerecordCnt;
+    }
+
+private:
+    struct Slot {
+        VkCommandPool pool = VK_NULL_HANDLE;
+        VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+        uint64_t key = 0;
+        bool recorded = false;
+    };
+// index: bucket * frameCnt + frame
+    std::vector<Slot> slots;
+    uint32_t frameCnt = 0;
+    uint64_t rerecordCnt = 0;
+};
+
+#endif
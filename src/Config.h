@@ -19,10 +19,60 @@ public:
     std::string title;
     size_t windowWidth, windowHeight;
     std::string spirvPath;
+// Optional keys, not counted in validOptionCnt
+    uint32_t framesInFlight = 2;
+// one of "fifo", "fifo_relaxed", "mailbox", "immediate", falls back towards fifo if unsupported
+    std::string presentMode = "fifo";
+// 0 lets the renderer pick (at least 2), otherwise clamped to what the surface allows
+    uint32_t swapchainImageCount = 0;
+// seconds between periodic frame-time reports, 0 reports on exit only
+    uint32_t telemetryInterval = 5;
+// per-frame samples are written here as csv if set
+    std::string telemetryCsv;
+// fixed simulation rate in Hz and max simulation steps run per rendered frame
+    uint32_t simRate = 60;
+    uint32_t simMaxCatchUp = 5;
+// frame cap (fps) while the window is visible but unfocused, 0 disables it;
+// hidden or minimized windows never render
+    uint32_t backgroundFrameCap = 30;
+// job system worker threads (submitting thread not included), 0 = one per core minus one;
+// jobAffinity pins worker i to core i + 1 (Linux only)
+    uint32_t jobWorkers = 0;
+    bool jobAffinity = false;
+// cached: each render bucket keeps its secondaries, re-recorded only when its draws or pipeline change;
+// perFrame: everything re-recorded every frame, draw lists shorter than 2 * recordChunkSize inline
+    std::string recordMode = "cached";
+    uint32_t recordChunkSize = 256;
+// cull the draw list on the compute queue (async where the device has a separate family)
+// and draw indirect from the results
+    bool asyncCompute = false;
+// staging ring for streaming uploads (MiB) and bytes staged per frame at most (KiB);
+// a single upload bigger than the budget still goes through, alone in its frame
+    uint32_t stagingRingMb = 32;
+    uint32_t uploadBudgetKb = 4096;
+// per-frame uniform / storage arena (KiB per frame in flight), see FrameArena.h
+    uint32_t frameArenaKb = 1024;
+// pipeline cache file relative to rootDir, kept across runs; empty disables it
+    std::string pipelineCache = "pipeline.cache";
+// shader variant (specialization constant) tinting the triangle with the animated hue
+    bool hueTint = false;
+// one of the built-in scenes in Scene.h
+    std::string scene = "triangle";
+// render offscreen without window / surface, for headless (e.g. lavapipe) runs
+    bool headless = false;
+    size_t headlessFrames = 1000;
     std::vector<const std::string> validKeys = {
         "rootDir", "title", "windowWidth", "windowHeight", "spirvPath" };
     size_t validOptionCnt = 0;
     
+// true / false / 1 / 0, anything else is an error naming the key
+    static inline bool parseBool (const std::string& key, const std::string& value)
+    {
+        if (value == "true" || value == "1") return true;
+        if (value == "false" || value == "0") return false;
+        throw std::runtime_error(std::format("{} expects true or false, got {}", key, value));
+    }
+
     Config () = delete;
     Config (Config& rhs) = delete;
     Config (Config&& rhs) = delete;
@@ -78,6 +128,61 @@ public:
                         }
                         spirvPath = value;
                         ++validOptionCnt;
+                    } else if (key == "framesInFlight") {
+                        framesInFlight = std::stoul(value);
+                        if (framesInFlight == 0) throw std::runtime_error("framesInFlight must be at least 1");
+                    } else if (key == "presentMode") {
+                        if (value != "fifo" && value != "fifo_relaxed" && value != "mailbox" && value != "immediate") {
+                            throw std::runtime_error(std::format("unknown presentMode {}", value));
+                        }
+                        presentMode = value;
+                    } else if (key == "swapchainImageCount") {
+                        swapchainImageCount = std::stoul(value);
+                    } else if (key == "telemetryInterval") {
+                        telemetryInterval = std::stoul(value);
+                    } else if (key == "telemetryCsv") {
+                        telemetryCsv = value;
+                    } else if (key == "simRate") {
+                        simRate = std::stoul(value);
+                        if (simRate == 0) throw std::runtime_error("simRate must be at least 1");
+                    } else if (key == "simMaxCatchUp") {
+                        simMaxCatchUp = std::stoul(value);
+                        if (simMaxCatchUp == 0) throw std::runtime_error("simMaxCatchUp must be at least 1");
+                    } else if (key == "backgroundFrameCap") {
+                        backgroundFrameCap = std::stoul(value);
+                    } else if (key == "jobWorkers") {
+                        jobWorkers = std::stoul(value);
+                    } else if (key == "jobAffinity") {
+                        jobAffinity = parseBool(key, value);
+                    } else if (key == "recordMode") {
+                        if (value != "cached" && value != "perFrame") {
+                            throw std::runtime_error(std::format("recordMode expects cached or perFrame, got {}", value));
+                        }
+                        recordMode = value;
+                    } else if (key == "recordChunkSize") {
+                        recordChunkSize = std::stoul(value);
+                        if (recordChunkSize == 0) throw std::runtime_error("recordChunkSize must be at least 1");
+                    } else if (key == "asyncCompute") {
+                        asyncCompute = parseBool(key, value);
+                    } else if (key == "stagingRingMb") {
+                        stagingRingMb = std::stoul(value);
+                        if (stagingRingMb == 0) throw std::runtime_error("stagingRingMb must be at least 1");
+                    } else if (key == "uploadBudgetKb") {
+                        uploadBudgetKb = std::stoul(value);
+                    } else if (key == "frameArenaKb") {
+                        frameArenaKb = std::stoul(value);
+                        if (frameArenaKb == 0) throw std::runtime_error("frameArenaKb must be at least 1");
+                    } else if (key == "pipelineCache") {
+                        pipelineCache = value;
+                    } else if (key == "hueTint") {
+                        hueTint = parseBool(key, value);
+                    } else if (key == "scene") {
+                        if (value.empty()) throw std::runtime_error("empty value");
+                        scene = value;
+                    } else if (key == "headless") {
+                        headless = parseBool(key, value);
+                    } else if (key == "headlessFrames") {
+                        headlessFrames = std::stoul(value);
                     } else {
                         std::cerr << "[Warning] Unknown config key: " << key << std::endl;
                     }
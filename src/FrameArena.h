@@ -0,0 +1,176 @@
+#ifndef FRAMEARENA_H
+#define FRAMEARENA_H
+
+#include <vulkan/vulkan.h>
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <format>
+#include <exception>
+#include "GpuAllocator.h"
+
+// Linear allocator for per-frame uniform / storage data.
+//
+// One persistently mapped buffer holds a slice of frameSize bytes per frame in
+// flight. beginFrame() rewinds the frame's slice (its previous submission must
+// have completed), after which push() is a bump-pointer write returning the
+// offset of the data in the buffer. Shaders see it through one descriptor set
+// with a single UNIFORM_BUFFER_DYNAMIC binding covering uniformRange bytes,
+// so per-draw data costs one vkCmdBindDescriptorSets with a dynamic offset and
+// never a descriptor update. push() is thread-safe (parallel recording).
+class FrameArena
+{
+public:
+    FrameArena () = default;
+    FrameArena (FrameArena& rhs) = delete;
+    FrameArena (FrameArena&& rhs) = delete;
+
+    inline void init (VkDevice device, const VkPhysicalDeviceProperties& props, GpuAllocator& allocator,
+        uint32_t frameCnt, VkDeviceSize frameSize)
+    {
+        this->allocator = &allocator;
+        alignment = std::max(props.limits.minUniformBufferOffsetAlignment, props.limits.minStorageBufferOffsetAlignment);
+        this->frameSize = (frameSize + alignment - 1) / alignment * alignment;
+        uniformRange = std::min<VkDeviceSize>({props.limits.maxUniformBufferRange, 65536, this->frameSize});
+    // Step 1: Buffer, one slice per frame plus uniformRange of tail so any dynamic offset
+    //         of the last slice still has the full range inside the buffer
+        {
+            VkBufferCreateInfo bufferCreateInfo;
+            auto& ci = bufferCreateInfo;
+            ci.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+            ci.pNext = nullptr;
+            ci.flags = 0;
+            ci.size = this->frameSize * frameCnt + uniformRange;
+            ci.usage = VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT | VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+            ci.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+            ci.queueFamilyIndexCount = 0;
+            ci.pQueueFamilyIndices = nullptr;
+            buffer = allocator.createBuffer(ci, MemoryUsage::Dynamic, allocation);
+            mapped = static_cast<char*>(allocation.mapped);
+        }
+    // Step 2: Set layout, pool and the one set, written once
+        {
+            VkDescriptorSetLayoutBinding binding;
+            binding.binding = 0;
+            binding.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+            binding.descriptorCount = 1;
+            binding.stageFlags = VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT;
+            binding.pImmutableSamplers = nullptr;
+            VkDescriptorSetLayoutCreateInfo descriptorSetLayoutCreateInfo;
+            auto& ci = descriptorSetLayoutCreateInfo;
+            ci.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO;
+            ci.pNext = nullptr;
+            ci.flags = 0;
+            ci.bindingCount = 1;
+            ci.pBindings = &binding;
+            VkResult r = vkCreateDescriptorSetLayout(device, &ci, nullptr, &descriptorSetLayout);
+            if (r != VK_SUCCESS) throw std::runtime_error(std::format("vkCreateDescriptorSetLayout: {}", (int)r));
+        }
+        {
+            VkDescriptorPoolSize poolSize = { VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC, 1 };
+            VkDescriptorPoolCreateInfo descriptorPoolCreateInfo;
+            auto& ci = descriptorPoolCreateInfo;
+            ci.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO;
+            ci.pNext = nullptr;
+            ci.flags = 0;
+            ci.maxSets = 1;
+            ci.poolSizeCount = 1;
+            ci.pPoolSizes = &poolSize;
+            VkResult r = vkCreateDescriptorPool(device, &ci, nullptr, &descriptorPool);
+            if (r != VK_SUCCESS) throw std::runtime_error(std::format("vkCreateDescriptorPool: {}", (int)r));
+            VkDescriptorSetAllocateInfo descriptorSetAllocateInfo;
+            auto& ai = descriptorSetAllocateInfo;
+            ai.sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO;
+            ai.pNext = nullptr;
+            ai.descriptorPool = descriptorPool;
+            ai.descriptorSetCount = 1;
+            ai.pSetLayouts = &descriptorSetLayout;
+            r = vkAllocateDescriptorSets(device, &ai, &descriptorSet);
+            if (r != VK_SUCCESS) throw std::runtime_error(std::format("vkAllocateDescriptorSets: {}", (int)r));
+        }
+        VkDescriptorBufferInfo bufferInfo = { buffer, 0, uniformRange };
+        VkWriteDescriptorSet write;
+        write.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
+        write.pNext = nullptr;
+        write.dstSet = descriptorSet;
+        write.dstBinding = 0;
+        write.dstArrayElement = 0;
+        write.descriptorCount = 1;
+        write.descriptorType = VK_DESCRIPTOR_TYPE_UNIFORM_BUFFER_DYNAMIC;
+        write.pImageInfo = nullptr;
+        write.pBufferInfo = &bufferInfo;
+        write.pTexelBufferView = nullptr;
+        vkUpdateDescriptorSets(device, 1, &write, 0, nullptr);
+    }
+    inline void destroy (VkDevice device)
+    {
+        if (descriptorPool == VK_NULL_HANDLE) return;
+        // frees descriptorSet too
+        vkDestroyDescriptorPool(device, descriptorPool, nullptr);
+        vkDestroyDescriptorSetLayout(device, descriptorSetLayout, nullptr);
+        allocator->destroyBuffer(buffer, allocation);
+        descriptorPool = VK_NULL_HANDLE;
+        descriptorSetLayout = VK_NULL_HANDLE;
+        buffer = VK_NULL_HANDLE;
+        mapped = nullptr;
+    }
+
+// Render thread, once the frame's previous submission has completed
+    inline void beginFrame (uint32_t frame)
+    {
+        base = frame * frameSize;
+        head.store(0, std::memory_order_relaxed);
+    }
+// Any thread while the frame is recorded. Copies size bytes into the frame's slice,
+// returns their offset in getBuffer() (the dynamic offset). Reads through the binding
+// must stay within uniformRange of it.
+    inline uint32_t push (const void* data, VkDeviceSize size)
+    {
+        VkDeviceSize aligned = (size + alignment - 1) / alignment * alignment;
+        VkDeviceSize offset = head.fetch_add(aligned, std::memory_order_relaxed);
+        if (offset + aligned > frameSize) {
+            throw std::runtime_error(std::format("FrameArena: frame slice of {} bytes exhausted", frameSize));
+        }
+        std::memcpy(mapped + base + offset, data, size);
+        return static_cast<uint32_t>(base + offset);
+    }
+    template <typename T>
+    inline uint32_t push (const T& data)
+    {
+        return push(&data, sizeof(T));
+    }
+// bytes pushed into the current frame so far
+    inline VkDeviceSize used () const
+    {
+        return head.load(std::memory_order_relaxed);
+    }
+    inline VkBuffer getBuffer () const
+    {
+        return buffer;
+    }
+    inline VkDescriptorSetLayout setLayout () const
+    {
+        return descriptorSetLayout;
+    }
+    inline VkDescriptorSet set () const
+    {
+        return descriptorSet;
+    }
+
+private:
+    GpuAllocator* allocator = nullptr;
+    VkBuffer buffer = VK_NULL_HANDLE;
+    GpuAllocation allocation;
+    char* mapped = nullptr;
+    VkDeviceSize alignment = 256;
+    VkDeviceSize frameSize = 0;
+    VkDeviceSize uniformRange = 0;
+    VkDescriptorSetLayout descriptorSetLayout = VK_NULL_HANDLE;
+    VkDescriptorPool descriptorPool = VK_NULL_HANDLE;
+    VkDescriptorSet descriptorSet = VK_NULL_HANDLE;
+// current frame: start of its slice, bytes used within it
+    VkDeviceSize base = 0;
+    std::atomic<VkDeviceSize> head = 0;
+};
+
+#endif
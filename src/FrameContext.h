@@ -0,0 +1,80 @@
+#ifndef FRAMECONTEXT_H
+#define FRAMECONTEXT_H
+
+#include <vulkan/vulkan.h>
+#include <format>
+#include <exception>
+
+// Resources owned by one frame in flight. The renderer keeps a ring of these
+// (size cfg.framesInFlight) and only reuses a context once its execFence has
+// signaled, so the CPU can record frame N+1 while the GPU still runs frame N.
+class FrameContext
+{
+public:
+// - imageAvailableSemaphore : in-GPU sync, the image acquired for this frame is ready for rendering
+// - execFence : CPU-GPU sync, this frame's submission has finished executing
+// - commandPool : transient pool, reset as a whole once execFence has signaled
+// - commandBuffer : primary command buffer re-recorded every frame (one-time submit)
+    VkSemaphore imageAvailableSemaphore = VK_NULL_HANDLE;
+    VkFence execFence = VK_NULL_HANDLE;
+    VkCommandPool commandPool = VK_NULL_HANDLE;
+    VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+
+    inline void init (VkDevice device, uint32_t queueFamilyIndex)
+    {
+        VkSemaphoreCreateInfo semaphoreCreateInfo;
+        {
+            auto& ci = semaphoreCreateInfo;
+            ci.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+            ci.pNext = nullptr;
+            ci.flags = 0;
+        }
+        VkFenceCreateInfo fenceCreateInfo;
+        {
+            auto& ci = fenceCreateInfo;
+            ci.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+            ci.pNext = nullptr;
+            // created in signaled state, so the first wait on a fresh context returns at once
+            ci.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+        }
+        VkResult r = vkCreateSemaphore(device, &semaphoreCreateInfo, nullptr, &imageAvailableSemaphore);
+        if (r != VK_SUCCESS) throw std::runtime_error(std::format("vkCreateSemaphore: {}", (int)r));
+        r = vkCreateFence(device, &fenceCreateInfo, nullptr, &execFence);
+        if (r != VK_SUCCESS) throw std::runtime_error(std::format("vkCreateFence: {}", (int)r));
+        VkCommandPoolCreateInfo commandPoolCreateInfo;
+        {
+            auto& ci = commandPoolCreateInfo;
+            ci.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+            ci.pNext = nullptr;
+            // short-lived buffers, no per-buffer reset: the whole pool is reset each frame
+            ci.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+            ci.queueFamilyIndex = queueFamilyIndex;
+        }
+        r = vkCreateCommandPool(device, &commandPoolCreateInfo, nullptr, &commandPool);
+        if (r != VK_SUCCESS) throw std::runtime_error(std::format("vkCreateCommandPool: {}", (int)r));
+        VkCommandBufferAllocateInfo commandBufferAllocateInfo;
+        {
+            auto& ai = commandBufferAllocateInfo;
+            ai.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+            ai.pNext = nullptr;
+            ai.commandPool = commandPool;
+            ai.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+            ai.commandBufferCount = 1;
+        }
+        r = vkAllocateCommandBuffers(device, &commandBufferAllocateInfo, &commandBuffer);
+        if (r != VK_SUCCESS) throw std::runtime_error(std::format("vkAllocateCommandBuffers: {}", (int)r));
+    }
+    inline void destroy (VkDevice device)
+    {
+        // frees commandBuffer too
+        vkDestroyCommandPool(device, commandPool, nullptr);
+        commandPool = VK_NULL_HANDLE;
+        commandBuffer = VK_NULL_HANDLE;
+        vkDestroyFence(device, execFence, nullptr);
+        vkDestroySemaphore(device, imageAvailableSemaphore, nullptr);
+        execFence = VK_NULL_HANDLE;
+        imageAvailableSemaphore = VK_NULL_HANDLE;
+    }
+};
+
+#endif
@@ -0,0 +1,405 @@
+#include "GpuAllocator.h"
+#include "utils.h"
+
+#include <algorithm>
+#include <bit>
+#include <format>
+#include <iostream>
+#include <limits>
+#include <stdexcept>
+
+BuddyAllocator::BuddyAllocator (uint64_t size, uint64_t minSize)
+: minSize (minSize),
+  maxOrder (0)
+{
+    while ((minSize << maxOrder) < size) {
+        ++maxOrder;
+    }
+    freeLists.resize(maxOrder + 1);
+    freeLists[maxOrder].insert(0);
+}
+
+bool BuddyAllocator::alloc (uint64_t size, uint64_t alignment, uint64_t& offset, uint32_t& order)
+{
+    uint64_t need = std::max({size, alignment, minSize});
+    uint32_t k = 0;
+    while ((minSize << k) < need) {
+        if (++k > maxOrder) return false;
+    }
+// smallest free range that fits, split down to order k keeping the lower halves
+    uint32_t j = k;
+    while (j <= maxOrder && freeLists[j].empty()) {
+        ++j;
+    }
+    if (j > maxOrder) return false;
+    uint64_t off = *freeLists[j].begin();
+    freeLists[j].erase(freeLists[j].begin());
+    while (j > k) {
+        --j;
+        freeLists[j].insert(off + (minSize << j));
+    }
+    offset = off;
+    order = k;
+    usedBytes += minSize << k;
+    return true;
+}
+
+void BuddyAllocator::free (uint64_t offset, uint32_t order)
+{
+    usedBytes -= minSize << order;
+    while (order < maxOrder) {
+        uint64_t buddy = offset ^ (minSize << order);
+        auto it = freeLists[order].find(buddy);
+        if (it == freeLists[order].end()) break;
+        freeLists[order].erase(it);
+        offset = std::min(offset, buddy);
+        ++order;
+    }
+    freeLists[order].insert(offset);
+}
+
+void GpuAllocator::init (VkPhysicalDevice physicalDevice, VkDevice device, bool memoryBudget)
+{
+    this->physicalDevice = physicalDevice;
+    this->device = device;
+    this->memoryBudget = memoryBudget;
+    vkGetPhysicalDeviceMemoryProperties(physicalDevice, &memoryProperties);
+    heapStats.resize(memoryProperties.memoryHeapCount);
+    heapBudgets.resize(memoryProperties.memoryHeapCount);
+    overBudget.assign(memoryProperties.memoryHeapCount, false);
+    for (uint32_t i = 0; i < memoryProperties.memoryHeapCount; ++i) {
+        heapStats[i].heapSize = memoryProperties.memoryHeaps[i].size;
+    }
+// pool index: memoryType * 2 + (linear ? 0 : 1); blocks stay below 1/8 of small heaps
+    pools.resize(memoryProperties.memoryTypeCount * 2);
+    for (uint32_t i = 0; i < pools.size(); ++i) {
+        auto& pool = pools[i];
+        pool.memoryType = i / 2;
+        pool.linear = (i % 2) == 0;
+        VkDeviceSize heapSize = memoryProperties.memoryHeaps[memoryProperties.memoryTypes[pool.memoryType].heapIndex].size;
+        pool.blockSize = defaultBlockSize;
+        while (pool.blockSize > heapSize / 8 && pool.blockSize > (VkDeviceSize(1) << 20)) {
+            pool.blockSize >>= 1;
+        }
+    }
+}
+
+void GpuAllocator::destroy ()
+{
+    std::lock_guard<std::mutex> lock(m);
+    for (auto& pool : pools) {
+        for (auto& block : pool.blocks) {
+            if (block.memory == VK_NULL_HANDLE) continue;
+            if (block.allocationCnt != 0) {
+                std::cerr << std::format("[Warning] GpuAllocator: {} allocations leaked in memory type {}", block.allocationCnt, pool.memoryType) << std::endl;
+            }
+            freeMemory(block.memory, block.mapped != nullptr);
+        }
+        pool.blocks.clear();
+    }
+}
+
+// Lowest cost type among the allowed ones with all required flags;
+// cost = preferred flags missing + flags to avoid present
+uint32_t GpuAllocator::selectMemoryType (uint32_t typeBits, MemoryUsage usage) const
+{
+    VkMemoryPropertyFlags required = 0, preferred = 0, avoided = 0;
+    switch (usage) {
+    case MemoryUsage::GpuOnly:
+        preferred = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+        avoided = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
+        break;
+    case MemoryUsage::Upload:
+        required = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+        // keep scarce device-local host-visible memory (ReBAR) for Dynamic
+        avoided = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT | VK_MEMORY_PROPERTY_HOST_CACHED_BIT;
+        break;
+    case MemoryUsage::Dynamic:
+        required = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT;
+        preferred = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT;
+        break;
+    case MemoryUsage::Readback:
+        required = VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
+        preferred = VK_MEMORY_PROPERTY_HOST_CACHED_BIT;
+        break;
+    }
+    uint32_t best = UINT32_MAX;
+    int bestCost = std::numeric_limits<int>::max();
+    for (uint32_t i = 0; i < memoryProperties.memoryTypeCount; ++i) {
+        if (!(typeBits & (1u << i))) continue;
+        VkMemoryPropertyFlags flags = memoryProperties.memoryTypes[i].propertyFlags;
+        if ((flags & required) != required) continue;
+        int cost = std::popcount(preferred & ~flags) + std::popcount(avoided & flags);
+        if (cost < bestCost) {
+            best = i;
+            bestCost = cost;
+        }
+    }
+    if (best == UINT32_MAX) throw std::runtime_error("no compatible memory type found");
+    return best;
+}
+
+VkDeviceMemory GpuAllocator::allocateMemory (VkDeviceSize size, uint32_t memoryType, const void* pNext, void** mapped)
+{
+    VkMemoryAllocateInfo memoryAllocateInfo;
+    auto& ai = memoryAllocateInfo;
+    ai.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+    ai.pNext = pNext;
+    ai.allocationSize = size;
+    ai.memoryTypeIndex = memoryType;
+    VkDeviceMemory memory;
+    VkResult r = vkAllocateMemory(device, &ai, nullptr, &memory);
+    if (r != VK_SUCCESS) throw std::runtime_error(std::format("vkAllocateMemory: {}", (int)r));
+    *mapped = nullptr;
+    if (hostVisible(memoryType)) {
+        r = vkMapMemory(device, memory, 0, VK_WHOLE_SIZE, 0, mapped);
+        if (r != VK_SUCCESS) {
+            vkFreeMemory(device, memory, nullptr);
+            throw std::runtime_error(std::format("vkMapMemory: {}", (int)r));
+        }
+    }
+    return memory;
+}
+
+void GpuAllocator::freeMemory (VkDeviceMemory memory, bool mapped)
+{
+    if (mapped) {
+        vkUnmapMemory(device, memory);
+    }
+    vkFreeMemory(device, memory, nullptr);
+}
+
+GpuAllocation GpuAllocator::allocate (const VkMemoryRequirements& requirements, MemoryUsage usage, bool linear)
+{
+    return allocate(requirements, usage, linear, false, nullptr);
+}
+
+GpuAllocation GpuAllocator::allocate (const VkMemoryRequirements& requirements, MemoryUsage usage, bool linear,
+    bool preferDedicated, const VkMemoryDedicatedAllocateInfo* dedicatedInfo)
+{
+    GpuAllocation a;
+    a.memoryType = selectMemoryType(requirements.memoryTypeBits, usage);
+    a.size = requirements.size;
+    uint32_t poolIdx = a.memoryType * 2 + (linear ? 0 : 1);
+    std::lock_guard<std::mutex> lock(m);
+    auto& pool = pools[poolIdx];
+    auto& hs = heapStats[memoryProperties.memoryTypes[a.memoryType].heapIndex];
+// Dedicated: driver's preference, or too large to sub-allocate without wasting most of a block
+    if (preferDedicated || requirements.size > pool.blockSize / 2) {
+        a.memory = allocateMemory(requirements.size, a.memoryType, dedicatedInfo, &(a.mapped));
+        a.offset = 0;
+        a.pool = UINT32_MAX;
+        ++hs.dedicatedCnt;
+        hs.dedicatedBytes += a.size;
+        return a;
+    }
+// Sub-allocation: first block with room, else a new block (reusing a released slot)
+    a.pool = poolIdx;
+    a.block = UINT32_MAX;
+    for (uint32_t i = 0; i < pool.blocks.size(); ++i) {
+        auto& block = pool.blocks[i];
+        if (block.memory == VK_NULL_HANDLE) continue;
+        if (block.buddy->alloc(requirements.size, requirements.alignment, a.offset, a.order)) {
+            a.block = i;
+            break;
+        }
+    }
+    if (a.block == UINT32_MAX) {
+        uint32_t slot = 0;
+        while (slot < pool.blocks.size() && pool.blocks[slot].memory != VK_NULL_HANDLE) {
+            ++slot;
+        }
+        if (slot == pool.blocks.size()) {
+            pool.blocks.emplace_back();
+        }
+        auto& block = pool.blocks[slot];
+        block.memory = allocateMemory(pool.blockSize, a.memoryType, nullptr, &(block.mapped));
+        block.buddy.reset(new BuddyAllocator(pool.blockSize, minAllocationSize));
+        block.allocationCnt = 0;
+        ++hs.blockCnt;
+        hs.blockBytes += pool.blockSize;
+        if (!block.buddy->alloc(requirements.size, requirements.alignment, a.offset, a.order)) {
+            throw std::runtime_error(std::format("GpuAllocator: {} bytes do not fit a fresh block", requirements.size));
+        }
+        a.block = slot;
+    }
+    auto& block = pool.blocks[a.block];
+    ++block.allocationCnt;
+    a.memory = block.memory;
+    a.mapped = block.mapped != nullptr ? static_cast<char*>(block.mapped) + a.offset : nullptr;
+    ++hs.allocationCnt;
+    hs.allocatedBytes += a.size;
+    return a;
+}
+
+void GpuAllocator::free (GpuAllocation& a)
+{
+    if (a.memory == VK_NULL_HANDLE) return;
+    std::lock_guard<std::mutex> lock(m);
+    auto& hs = heapStats[memoryProperties.memoryTypes[a.memoryType].heapIndex];
+    if (a.pool == UINT32_MAX) {
+        freeMemory(a.memory, a.mapped != nullptr);
+        --hs.dedicatedCnt;
+        hs.dedicatedBytes -= a.size;
+    } else {
+        auto& pool = pools[a.pool];
+        auto& block = pool.blocks[a.block];
+        block.buddy->free(a.offset, a.order);
+        --block.allocationCnt;
+        --hs.allocationCnt;
+        hs.allocatedBytes -= a.size;
+    // keep one empty block per pool around so alloc / free cycles do not hit the driver
+        if (block.allocationCnt == 0) {
+            size_t emptyCnt = std::count_if(pool.blocks.begin(), pool.blocks.end(), [] (const Block& b) {
+                return b.memory != VK_NULL_HANDLE && b.allocationCnt == 0;
+            });
+            if (emptyCnt > 1) {
+                freeMemory(block.memory, block.mapped != nullptr);
+                block.memory = VK_NULL_HANDLE;
+                block.mapped = nullptr;
+                block.buddy.reset();
+                --hs.blockCnt;
+                hs.blockBytes -= pool.blockSize;
+            }
+        }
+    }
+    a = GpuAllocation();
+}
+
+VkBuffer GpuAllocator::createBuffer (const VkBufferCreateInfo& createInfo, MemoryUsage usage, GpuAllocation& allocation)
+{
+    VkBuffer buffer;
+    VkResult r = vkCreateBuffer(device, &createInfo, nullptr, &buffer);
+    if (r != VK_SUCCESS) throw std::runtime_error(std::format("vkCreateBuffer: {}", (int)r));
+    VkMemoryDedicatedRequirements dedicatedRequirements = {};
+    dedicatedRequirements.sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_REQUIREMENTS;
+    VkMemoryRequirements2 memoryRequirements = {};
+    memoryRequirements.sType = VK_STRUCTURE_TYPE_MEMORY_REQUIREMENTS_2;
+    memoryRequirements.pNext = &dedicatedRequirements;
+    VkBufferMemoryRequirementsInfo2 requirementsInfo = {};
+    requirementsInfo.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_REQUIREMENTS_INFO_2;
+    requirementsInfo.buffer = buffer;
+    vkGetBufferMemoryRequirements2(device, &requirementsInfo, &memoryRequirements);
+    VkMemoryDedicatedAllocateInfo dedicatedInfo = {};
+    dedicatedInfo.sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_ALLOCATE_INFO;
+    dedicatedInfo.buffer = buffer;
+    bool preferDedicated = dedicatedRequirements.prefersDedicatedAllocation || dedicatedRequirements.requiresDedicatedAllocation;
+    allocation = allocate(memoryRequirements.memoryRequirements, usage, true, preferDedicated, &dedicatedInfo);
+    r = vkBindBufferMemory(device, buffer, allocation.memory, allocation.offset);
+    if (r != VK_SUCCESS) throw std::runtime_error(std::format("vkBindBufferMemory: {}", (int)r));
+    return buffer;
+}
+
+VkImage GpuAllocator::createImage (const VkImageCreateInfo& createInfo, MemoryUsage usage, GpuAllocation& allocation)
+{
+    VkImage image;
+    VkResult r = vkCreateImage(device, &createInfo, nullptr, &image);
+    if (r != VK_SUCCESS) throw std::runtime_error(std::format("vkCreateImage: {}", (int)r));
+    VkMemoryDedicatedRequirements dedicatedRequirements = {};
+    dedicatedRequirements.sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_REQUIREMENTS;
+    VkMemoryRequirements2 memoryRequirements = {};
+    memoryRequirements.sType = VK_STRUCTURE_TYPE_MEMORY_REQUIREMENTS_2;
+    memoryRequirements.pNext = &dedicatedRequirements;
+    VkImageMemoryRequirementsInfo2 requirementsInfo = {};
+    requirementsInfo.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_REQUIREMENTS_INFO_2;
+    requirementsInfo.image = image;
+    vkGetImageMemoryRequirements2(device, &requirementsInfo, &memoryRequirements);
+    VkMemoryDedicatedAllocateInfo dedicatedInfo = {};
+    dedicatedInfo.sType = VK_STRUCTURE_TYPE_MEMORY_DEDICATED_ALLOCATE_INFO;
+    dedicatedInfo.image = image;
+    bool preferDedicated = dedicatedRequirements.prefersDedicatedAllocation || dedicatedRequirements.requiresDedicatedAllocation;
+    allocation = allocate(memoryRequirements.memoryRequirements, usage, createInfo.tiling == VK_IMAGE_TILING_LINEAR,
+        preferDedicated, &dedicatedInfo);
+    r = vkBindImageMemory(device, image, allocation.memory, allocation.offset);
+    if (r != VK_SUCCESS) throw std::runtime_error(std::format("vkBindImageMemory: {}", (int)r));
+    return image;
+}
+
+void GpuAllocator::destroyBuffer (VkBuffer buffer, GpuAllocation& allocation)
+{
+    vkDestroyBuffer(device, buffer, nullptr);
+    free(allocation);
+}
+
+void GpuAllocator::destroyImage (VkImage image, GpuAllocation& allocation)
+{
+    vkDestroyImage(device, image, nullptr);
+    free(allocation);
+}
+
+std::vector<GpuAllocator::HeapStats> GpuAllocator::stats ()
+{
+    std::lock_guard<std::mutex> lock(m);
+    return heapStats;
+}
+
+void GpuAllocator::logStats ()
+{
+    auto mib = [] (VkDeviceSize bytes) { return bytes / double(1 << 20); };
+    auto all = stats();
+    for (uint32_t i = 0; i < all.size(); ++i) {
+        auto& hs = all[i];
+        if (hs.blockCnt == 0 && hs.dedicatedCnt == 0) continue;
+        logInfo(std::format("Heap {} ({:.0f} MiB): {} blocks {:.1f} MiB, {} allocations {:.1f} MiB, {} dedicated {:.1f} MiB",
+            i, mib(hs.heapSize), hs.blockCnt, mib(hs.blockBytes), hs.allocationCnt, mib(hs.allocatedBytes),
+            hs.dedicatedCnt, mib(hs.dedicatedBytes)));
+    }
+}
+
+void GpuAllocator::updateBudget ()
+{
+// Step 1: Usage and budget per heap
+    if (memoryBudget) {
+        VkPhysicalDeviceMemoryBudgetPropertiesEXT budgetProperties = {};
+        budgetProperties.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_BUDGET_PROPERTIES_EXT;
+        VkPhysicalDeviceMemoryProperties2 memoryProperties2 = {};
+        memoryProperties2.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MEMORY_PROPERTIES_2;
+        memoryProperties2.pNext = &budgetProperties;
+        vkGetPhysicalDeviceMemoryProperties2(physicalDevice, &memoryProperties2);
+        for (uint32_t i = 0; i < heapBudgets.size(); ++i) {
+            heapBudgets[i].usage = budgetProperties.heapUsage[i];
+            heapBudgets[i].budget = budgetProperties.heapBudget[i];
+        }
+    } else {
+        std::lock_guard<std::mutex> lock(m);
+        for (uint32_t i = 0; i < heapBudgets.size(); ++i) {
+            heapBudgets[i].usage = heapStats[i].blockBytes + heapStats[i].dedicatedBytes;
+            heapBudgets[i].budget = heapStats[i].heapSize / 10 * 8;
+        }
+    }
+// Step 2: Evict on heaps close to their budget, back down to evictionTarget
+    std::lock_guard<std::mutex> lock(callbackMutex);
+    for (uint32_t i = 0; i < heapBudgets.size(); ++i) {
+        auto& hb = heapBudgets[i];
+        if (hb.usage <= hb.budget * evictionThreshold) {
+            overBudget[i] = false;
+            continue;
+        }
+        VkDeviceSize target = static_cast<VkDeviceSize>(hb.budget * evictionTarget);
+        VkDeviceSize needed = hb.usage - target;
+        VkDeviceSize released = 0;
+        for (auto& [id, callback] : evictionCallbacks) {
+            if (released >= needed) break;
+            released += callback(i, needed - released);
+        }
+        if (hb.usage - std::min(released, hb.usage) > hb.budget && !overBudget[i]) {
+            overBudget[i] = true;
+            std::cerr << std::format("[Warning] memory heap {} over budget: {} MiB used of {} MiB, {} MiB evicted",
+                i, hb.usage >> 20, hb.budget >> 20, released >> 20) << std::endl;
+        }
+    }
+}
+
+uint32_t GpuAllocator::addEvictionCallback (EvictionCallback callback)
+{
+    std::lock_guard<std::mutex> lock(callbackMutex);
+    uint32_t id = nextCallbackId++;
+    evictionCallbacks.emplace_back(id, std::move(callback));
+    return id;
+}
+
+void GpuAllocator::removeEvictionCallback (uint32_t id)
+{
+    std::lock_guard<std::mutex> lock(callbackMutex);
+    std::erase_if(evictionCallbacks, [id] (const auto& el) { return el.first == id; });
+}
@@ -0,0 +1,180 @@
+#ifndef GPUALLOCATOR_H
+#define GPUALLOCATOR_H
+
+#include <vulkan/vulkan.h>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <vector>
+
+// Binary buddy sub-allocator over one block of `size` bytes (power of two).
+// Order k hands out ranges of minSize << k bytes, aligned to their own size,
+// so any power-of-two alignment up to the range size comes for free.
+// Free ranges per order are kept sorted, buddies merge on free.
+class BuddyAllocator
+{
+public:
+    BuddyAllocator (uint64_t size, uint64_t minSize);
+
+    bool alloc (uint64_t size, uint64_t alignment, uint64_t& offset, uint32_t& order);
+    void free (uint64_t offset, uint32_t order);
+    inline uint64_t used () const
+    {
+        return usedBytes;
+    }
+    inline uint64_t size () const
+    {
+        return minSize << maxOrder;
+    }
+
+private:
+    uint64_t minSize;
+    uint32_t maxOrder;
+    uint64_t usedBytes = 0;
+    std::vector<std::set<uint64_t>> freeLists;
+};
+
+// How the CPU touches an allocation, decides the memory type
+enum class MemoryUsage
+{
+    GpuOnly,    // device local, never mapped
+    Upload,     // host visible + coherent, CPU writes once / GPU reads (staging)
+    Dynamic,    // host visible + coherent, CPU writes often / GPU reads; device local if possible (ReBAR / UMA)
+    Readback    // host visible, cached if possible, GPU writes / CPU reads
+};
+
+struct GpuAllocation
+{
+    VkDeviceMemory memory = VK_NULL_HANDLE;
+    VkDeviceSize offset = 0;
+    VkDeviceSize size = 0;
+// host visible usages only: persistently mapped pointer to offset
+    void* mapped = nullptr;
+// internal: owning pool and buddy order, pool UINT32_MAX = dedicated allocation
+    uint32_t pool = UINT32_MAX;
+    uint32_t block = 0;
+    uint32_t order = 0;
+    uint32_t memoryType = 0;
+};
+
+// Engine-owned device memory allocator.
+//
+// Memory is taken from the driver in large blocks (blockSize, smaller on small
+// heaps) and carved with a buddy allocator, so the number of vkAllocateMemory
+// calls stays far below maxMemoryAllocationCount. Pools are per (memory type,
+// linear / optimal tiling): linear and optimal resources never share a block,
+// which satisfies bufferImageGranularity without per-allocation checks.
+// Resources the driver prefers dedicated, or larger than half a block, get
+// their own VkDeviceMemory. Host-visible blocks are mapped once, for their lifetime.
+//
+// Budget: updateBudget() refreshes per-heap usage / budget, from VK_EXT_memory_budget
+// (whole process, as the driver sees it) when enabled, else estimated from what this
+// allocator holds against 80% of the heap size. Heaps above evictionThreshold of their
+// budget run the eviction callbacks (caches dropping cold resources) until they are
+// back under evictionTarget.
+// Thread-safe.
+class GpuAllocator
+{
+public:
+    struct HeapStats {
+        VkDeviceSize heapSize = 0;
+        uint32_t blockCnt = 0;
+        VkDeviceSize blockBytes = 0;
+        uint32_t allocationCnt = 0;
+        VkDeviceSize allocatedBytes = 0;
+        uint32_t dedicatedCnt = 0;
+        VkDeviceSize dedicatedBytes = 0;
+    };
+
+    struct HeapBudget {
+        VkDeviceSize usage = 0;
+        VkDeviceSize budget = 0;
+    };
+// Called with a heap index and the bytes to release from it, returns the bytes it released.
+// Runs on the thread calling updateBudget(), which is between frames on the render thread:
+// resources still used by frames in flight must be retired later, not destroyed right away
+// (they may report the bytes as released already). Must not add / remove callbacks.
+    using EvictionCallback = std::function<VkDeviceSize(uint32_t heap, VkDeviceSize bytes)>;
+
+    static constexpr VkDeviceSize defaultBlockSize = VkDeviceSize(64) << 20;
+    static constexpr double evictionThreshold = 0.9;
+    static constexpr double evictionTarget = 0.8;
+    static constexpr VkDeviceSize minAllocationSize = 256;
+
+    GpuAllocator () = default;
+    GpuAllocator (GpuAllocator& rhs) = delete;
+    GpuAllocator (GpuAllocator&& rhs) = delete;
+
+// memoryBudget: VK_EXT_memory_budget is enabled on the device
+    void init (VkPhysicalDevice physicalDevice, VkDevice device, bool memoryBudget);
+// all allocations must have been freed; blocks still held are released
+    void destroy ();
+
+    uint32_t selectMemoryType (uint32_t typeBits, MemoryUsage usage) const;
+// linear: buffers and linear-tiling images, false for optimal-tiling images
+    GpuAllocation allocate (const VkMemoryRequirements& requirements, MemoryUsage usage, bool linear);
+    void free (GpuAllocation& allocation);
+
+// create + allocate + bind in one go
+    VkBuffer createBuffer (const VkBufferCreateInfo& createInfo, MemoryUsage usage, GpuAllocation& allocation);
+    VkImage createImage (const VkImageCreateInfo& createInfo, MemoryUsage usage, GpuAllocation& allocation);
+    void destroyBuffer (VkBuffer buffer, GpuAllocation& allocation);
+    void destroyImage (VkImage image, GpuAllocation& allocation);
+
+    std::vector<HeapStats> stats ();
+    void logStats ();
+
+// Render thread, between frames
+    void updateBudget ();
+    inline const std::vector<HeapBudget>& budgets () const
+    {
+        return heapBudgets;
+    }
+    inline uint32_t heapCount () const
+    {
+        return memoryProperties.memoryHeapCount;
+    }
+    uint32_t addEvictionCallback (EvictionCallback callback);
+    void removeEvictionCallback (uint32_t id);
+
+private:
+    struct Block {
+        VkDeviceMemory memory = VK_NULL_HANDLE;
+        void* mapped = nullptr;
+        std::unique_ptr<BuddyAllocator> buddy;
+        uint32_t allocationCnt = 0;
+    };
+    struct Pool {
+        uint32_t memoryType = 0;
+        bool linear = true;
+        VkDeviceSize blockSize = 0;
+        std::vector<Block> blocks;
+    };
+
+    VkPhysicalDevice physicalDevice = VK_NULL_HANDLE;
+    VkDevice device = VK_NULL_HANDLE;
+    bool memoryBudget = false;
+    VkPhysicalDeviceMemoryProperties memoryProperties;
+    std::vector<Pool> pools;
+    std::vector<HeapStats> heapStats;
+    std::mutex m;
+    std::vector<HeapBudget> heapBudgets;
+// heaps that stayed over budget after eviction, warned about once until they recover
+    std::vector<bool> overBudget;
+    std::mutex callbackMutex;
+    std::vector<std::pair<uint32_t, EvictionCallback>> evictionCallbacks;
+    uint32_t nextCallbackId = 1;
+
+    GpuAllocation allocate (const VkMemoryRequirements& requirements, MemoryUsage usage, bool linear,
+        bool preferDedicated, const VkMemoryDedicatedAllocateInfo* dedicatedInfo);
+    VkDeviceMemory allocateMemory (VkDeviceSize size, uint32_t memoryType, const void* pNext, void** mapped);
+    void freeMemory (VkDeviceMemory memory, bool mapped);
+    inline bool hostVisible (uint32_t memoryType) const
+    {
+        return memoryProperties.memoryTypes[memoryType].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT;
+    }
+};
+
+#endif
@@ -0,0 +1,155 @@
+#ifndef GPUPROFILER_H
+#define GPUPROFILER_H
+
+#include <vulkan/vulkan.h>
+#include <array>
+#include <vector>
+#include <string>
+#include <format>
+#include <exception>
+#include "utils.h"
+#include "Telemetry.h"
+
+// Named GPU scopes measured with timestamp queries.
+// The query pool holds one range of 2 * maxScopes queries per slot; a slot is
+// whatever unit of command buffers is re-submitted together (one per frame in
+// flight or per baked swapchain image). Results of a slot are read back without
+// waiting, right before the slot is recorded / submitted again, i.e. a few frames late.
+class GpuProfiler
+{
+public:
+    static constexpr uint32_t maxScopes = 16;
+// per-scope sample history for percentiles, power of two
+    static constexpr size_t historySize = 256;
+
+    inline void init (VkDevice device, const VkPhysicalDeviceProperties& props,
+                      const VkQueueFamilyProperties& queueFamily, uint32_t slotCnt)
+    {
+        destroy(device);
+        timestampPeriod = props.limits.timestampPeriod;
+        validBits = queueFamily.timestampValidBits;
+    // queue family without timestamp support: every call below is a no-op
+        if (validBits == 0) {
+            logInfo("GPU timestamps not supported by queue family, profiler disabled");
+            return;
+        }
+        VkQueryPoolCreateInfo queryPoolCreateInfo;
+        auto& ci = queryPoolCreateInfo;
+        ci.sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO;
+        ci.pNext = nullptr;
+        ci.flags = 0;
+        ci.queryType = VK_QUERY_TYPE_TIMESTAMP;
+        ci.queryCount = slotCnt * 2 * maxScopes;
+        ci.pipelineStatistics = 0;
+        VkResult r = vkCreateQueryPool(device, &ci, nullptr, &queryPool);
+        if (r != VK_SUCCESS) throw std::runtime_error(std::format("vkCreateQueryPool: {}", (int)r));
+        slotScopes.assign(slotCnt, {});
+        slotScopeCnt.assign(slotCnt, 0);
+    }
+    inline void destroy (VkDevice device)
+    {
+        if (queryPool != VK_NULL_HANDLE) {
+            vkDestroyQueryPool(device, queryPool, nullptr);
+            queryPool = VK_NULL_HANDLE;
+        }
+    }
+    inline bool enabled () const
+    {
+        return queryPool != VK_NULL_HANDLE;
+    }
+
+// Recording, must be called outside of a render pass
+    inline void beginFrame (VkCommandBuffer cb, uint32_t slot)
+    {
+        if (!enabled()) return;
+        vkCmdResetQueryPool(cb, queryPool, slot * 2 * maxScopes, 2 * maxScopes);
+        slotScopeCnt[slot] = 0;
+    }
+// Recording, returns the scope index to pass to endScope
+    inline uint32_t beginScope (VkCommandBuffer cb, uint32_t slot, const char* name)
+    {
+        if (!enabled()) return 0;
+        uint32_t scope = slotScopeCnt[slot]++;
+        if (scope >= maxScopes) throw std::runtime_error("GpuProfiler: too many scopes");
+        slotScopes[slot][scope] = name;
+        vkCmdWriteTimestamp(cb, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, queryPool, query(slot, scope));
+        return scope;
+    }
+    inline void endScope (VkCommandBuffer cb, uint32_t slot, uint32_t scope)
+    {
+        if (!enabled()) return;
+        vkCmdWriteTimestamp(cb, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, queryPool, query(slot, scope) + 1);
+    }
+
+// Read back the last submission of a slot without blocking.
+// Only call once that submission is known to have been made; returns the
+// GPU time spanned by all scopes in ns, or 0 if results are not available yet.
+    inline uint64_t collect (VkDevice device, uint32_t slot)
+    {
+        if (!enabled() || slotScopeCnt[slot] == 0) return 0;
+        uint32_t cnt = slotScopeCnt[slot];
+        std::array<uint64_t, 2 * maxScopes> ticks;
+        VkResult r = vkGetQueryPoolResults(device, queryPool, query(slot, 0), 2 * cnt,
+            sizeof(ticks), ticks.data(), sizeof(uint64_t), VK_QUERY_RESULT_64_BIT);
+        if (r == VK_NOT_READY) return 0;
+        if (r != VK_SUCCESS) throw std::runtime_error(std::format("vkGetQueryPoolResults: {}", (int)r));
+        uint64_t mask = validBits == 64 ? ~0ull : ((1ull << validBits) - 1);
+        uint64_t first = ticks[0] & mask, last = first;
+        for (uint32_t i = 0; i < cnt; ++i) {
+            uint64_t b = ticks[2 * i] & mask, e = ticks[2 * i + 1] & mask;
+            record(slotScopes[slot][i], toNs(e - b));
+            first = std::min(first, b);
+            last = std::max(last, e);
+        }
+        return toNs(last - first);
+    }
+
+    inline void report ()
+    {
+        if (!enabled() || history.empty()) return;
+        logInfo("GPU scopes, in ms:");
+        for (auto& h : history) {
+            std::vector<uint64_t> values(h.ns.begin(), h.ns.begin() + std::min<uint64_t>(h.cnt, historySize));
+            Telemetry::Summary s = Telemetry::summarize(values);
+            logInfo(std::format("- {:<14} p50 {:8.3f}  p95 {:8.3f}  p99 {:8.3f}  max {:8.3f}",
+                h.name, s.p50 / 1e6, s.p95 / 1e6, s.p99 / 1e6, s.max / 1e6));
+        }
+    }
+
+private:
+    struct ScopeHistory {
+        std::string name;
+        uint64_t cnt = 0;
+        std::array<uint64_t, historySize> ns;
+    };
+
+    VkQueryPool queryPool = VK_NULL_HANDLE;
+    float timestampPeriod = 1.0f;
+    uint32_t validBits = 0;
+// names of scopes recorded into each slot, in recording order
+    std::vector<std::array<const char*, maxScopes>> slotScopes;
+    std::vector<uint32_t> slotScopeCnt;
+    std::vector<ScopeHistory> history;
+
+    inline uint32_t query (uint32_t slot, uint32_t scope) const
+    {
+        return slot * 2 * maxScopes + 2 * scope;
+    }
+    inline uint64_t toNs (uint64_t ticks) const
+    {
+        return static_cast<uint64_t>(ticks * static_cast<double>(timestampPeriod));
+    }
+    inline void record (const char* name, uint64_t ns)
+    {
+        for (auto& h : history) {
+            if (h.name == name) {
+                h.ns[h.cnt++ & (historySize - 1)] = ns;
+                return;
+            }
+        }
+        history.push_back(ScopeHistory { .name = name });
+        history.back().ns[history.back().cnt++] = ns;
+    }
+};
+
+#endif
@@ -0,0 +1,35 @@
+#include "Headless.h"
+#include "utils.h"
+
+#include <exception>
+
+Headless::Headless (Config& cfg)
+: frameLimit (cfg.headlessFrames)
+{
+    // no windowing system, so no surface instance extensions either
+    vulkanCtx.reset(new Vulkan({}, cfg));
+    vulkanCtx->initHeadless();
+    logInfo(std::format("Headless run for {} frames", frameLimit));
+}
+
+Headless::~Headless ()
+{
+    vulkanCtx.reset();
+}
+
+void Headless::run ()
+{
+    while (running) {
+        eventLoop();
+        if (!running) break;
+        render();
+    }
+}
+
+// counts the frame about to be rendered, stops once frameLimit have been
+void Headless::eventLoop ()
+{
+    if (++frameCnt > frameLimit) {
+        running = false;
+    }
+}
@@ -0,0 +1,36 @@
+#ifndef HEADLESS_H
+#define HEADLESS_H
+
+#include <string>
+#include <vector>
+#include <memory>
+#include "Vulkan.h"
+
+// Counterpart of Sdl for display-less runs: no window, no surface, renders
+// cfg.headlessFrames frames into offscreen images and stops.
+class Headless
+{
+private:
+    std::unique_ptr<Vulkan> vulkanCtx = nullptr;
+    size_t frameCnt = 0;
+    size_t frameLimit = 0;
+
+public:
+    bool running = true;
+
+    Headless (Config& cfg);
+    ~Headless ();
+// Render until the frame limit is reached
+    void run ();
+    void eventLoop ();
+    inline void render()
+    {
+        vulkanCtx->render();
+    }
+    inline Vulkan& getVulkan ()
+    {
+        return *vulkanCtx;
+    }
+};
+
+#endif
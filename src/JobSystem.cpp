@@ -0,0 +1,196 @@
+#include "JobSystem.h"
+#include "utils.h"
+
+#include <format>
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+// UINT32_MAX for threads that are not workers of the job system
+static thread_local uint32_t tlsWorkerIdx = UINT32_MAX;
+
+JobSystem::JobSystem (uint32_t workerCnt, bool pinWorkers)
+{
+    uint32_t coreCnt = std::max(1u, std::thread::hardware_concurrency());
+    if (workerCnt == 0) {
+        workerCnt = std::max(1u, coreCnt - 1);
+    }
+    threads.resize(workerCnt + 1);
+    for (auto& el : threads) {
+        el.reset(new ThreadState());
+    }
+    workers.reserve(workerCnt);
+    for (uint32_t i = 0; i < workerCnt; ++i) {
+        workers.emplace_back(&JobSystem::workerLoop, this, i);
+        if (pinWorkers) {
+#ifdef __linux__
+            cpu_set_t set;
+            CPU_ZERO(&set);
+            CPU_SET((i + 1) % coreCnt, &set);
+            if (pthread_setaffinity_np(workers.back().native_handle(), sizeof(set), &set) != 0) {
+                std::cerr << "[Warning] could not pin job worker " << i << std::endl;
+            }
+#endif
+        }
+    }
+#ifndef __linux__
+    if (pinWorkers) {
+        std::cerr << "[Warning] jobAffinity is not supported on this platform, ignored" << std::endl;
+    }
+#endif
+    logInfo(std::format("Job system: {} workers{}", workerCnt, pinWorkers ? ", pinned" : ""));
+}
+
+JobSystem::~JobSystem ()
+{
+    {
+        std::lock_guard<std::mutex> lock(wakeMutex);
+        stop = true;
+    }
+    wakeCv.notify_all();
+    for (auto& el : workers) {
+        el.join();
+    }
+}
+
+uint32_t JobSystem::threadIndex () const
+{
+    return tlsWorkerIdx != UINT32_MAX ? tlsWorkerIdx : workers.size();
+}
+
+JobSystem::Job* JobSystem::allocJob ()
+{
+    auto& ts = *threads[threadIndex()];
+    Job* job = &(ts.jobs[ts.nextJob]);
+    ts.nextJob = (ts.nextJob + 1) % jobPoolSize;
+    return job;
+}
+
+void JobSystem::push (Job* job)
+{
+    if (!threads[threadIndex()]->deque.push(job)) {
+    // deque full: no room to defer, run it right here
+        execute(job);
+        return;
+    }
+    queuedJobs.fetch_add(1, std::memory_order_seq_cst);
+// a worker about to sleep either sees queuedJobs > 0 or is seen in sleepingWorkers;
+// taking the lock makes sure it is already waiting when notified
+    if (sleepingWorkers.load(std::memory_order_seq_cst) > 0) {
+        { std::lock_guard<std::mutex> lock(wakeMutex); }
+        wakeCv.notify_one();
+    }
+}
+
+void JobSystem::run (Fn fn, Counter* signal, Counter* after)
+{
+    Job* job = allocJob();
+    job->fn = std::move(fn);
+    job->signal = signal;
+    if (signal != nullptr) {
+        signal->value.fetch_add(1, std::memory_order_relaxed);
+    }
+    if (after != nullptr) {
+        std::lock_guard<std::mutex> lock(after->m);
+        if (after->value.load(std::memory_order_acquire) != 0) {
+            after->waiters.push_back(job);
+            return;
+        }
+    }
+    push(job);
+}
+
+JobSystem::Job* JobSystem::find (uint32_t self)
+{
+    Job* job = threads[self]->deque.pop();
+    if (job == nullptr) {
+    // steal, starting next to ourselves so thieves spread over victims
+        for (uint32_t i = 1; i < threads.size() && job == nullptr; ++i) {
+            job = threads[(self + i) % threads.size()]->deque.steal();
+        }
+    }
+    if (job != nullptr) {
+        queuedJobs.fetch_sub(1, std::memory_order_relaxed);
+    }
+    return job;
+}
+
+void JobSystem::execute (Job* job)
+{
+    Fn fn = std::move(job->fn);
+    Counter* signal = job->signal;
+    try {
+        fn();
+    } catch (...) {
+        if (signal != nullptr) {
+            std::lock_guard<std::mutex> lock(signal->m);
+            if (!signal->error) signal->error = std::current_exception();
+        } else {
+            std::cerr << "[Error] job without counter threw, exception dropped" << std::endl;
+        }
+    }
+    if (signal == nullptr) return;
+// last one out releases the jobs parked on this counter. The decrement happens under
+// the counter's mutex: wait() takes it after seeing zero, so it cannot return (and the
+// owner cannot destroy the counter) while this thread still touches it.
+    std::vector<Job*> released;
+    {
+        std::lock_guard<std::mutex> lock(signal->m);
+        if (signal->value.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+            released.swap(signal->waiters);
+        }
+    }
+    for (auto& el : released) {
+        push(el);
+    }
+}
+
+void JobSystem::wait (Counter& c)
+{
+    uint32_t self = threadIndex();
+    while (!c.done()) {
+        Job* job = find(self);
+        if (job != nullptr) {
+            execute(job);
+        } else {
+            std::this_thread::yield();
+        }
+    }
+    std::exception_ptr error = nullptr;
+    {
+        // also waits for the job that brought c to zero to let go of it, see execute()
+        std::lock_guard<std::mutex> lock(c.m);
+        std::swap(error, c.error);
+    }
+    if (error) {
+        std::rethrow_exception(error);
+    }
+}
+
+void JobSystem::workerLoop (uint32_t idx)
+{
+    tlsWorkerIdx = idx;
+    // spin a little before sleeping, jobs tend to come in bursts (one per frame)
+    constexpr uint32_t spinLimit = 256;
+    uint32_t idleSpins = 0;
+    while (!stop.load(std::memory_order_relaxed)) {
+        Job* job = find(idx);
+        if (job != nullptr) {
+            execute(job);
+            idleSpins = 0;
+            continue;
+        }
+        if (++idleSpins < spinLimit) {
+            std::this_thread::yield();
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(wakeMutex);
+        sleepingWorkers.fetch_add(1, std::memory_order_seq_cst);
+        wakeCv.wait(lock, [this] {
+            return stop.load(std::memory_order_relaxed) || queuedJobs.load(std::memory_order_seq_cst) > 0;
+        });
+        sleepingWorkers.fetch_sub(1, std::memory_order_relaxed);
+        idleSpins = 0;
+    }
+}
@@ -0,0 +1,206 @@
+#ifndef JOBSYSTEM_H
+#define JOBSYSTEM_H
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <exception>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+// Work-stealing job system, the one place engine work fans out onto all cores.
+//
+// Every worker owns a Chase-Lev deque: it pushes / pops jobs at the bottom,
+// idle workers steal from the top of the others. Threads outside the system
+// (main thread during init, render thread per frame) share one extra slot,
+// so threadCount() is workers + 1 and outside threads get index workers.size();
+// only one outside thread may submit at a time, and a new one may take the slot
+// over only after a happens-before with the last (e.g. it was started or joined by it).
+//
+// Completion is tracked with Counters: run() increments the job's signal
+// counter, finishing the job decrements it. A job can be made to run after
+// another counter reaches zero; it is parked on that counter and released by
+// the job that brings it to zero. wait() helps executing jobs instead of blocking.
+class JobSystem
+{
+    struct Job;
+
+public:
+// void() stored inline in the pooled job slot, so scheduling never allocates. Takes
+// trivially copyable callables of up to inlineSize bytes (lambdas capturing pointers,
+// references and indices); anything bigger should capture a pointer to its state.
+    class Fn
+    {
+    public:
+        static constexpr size_t inlineSize = 48;
+
+        Fn () = default;
+        template <typename F>
+            requires (!std::is_same_v<std::decay_t<F>, Fn>)
+        Fn (F f)
+        {
+            static_assert(sizeof(F) <= inlineSize && alignof(F) <= alignof(std::max_align_t), "JobSystem::Fn: capture too large");
+            static_assert(std::is_trivially_copyable_v<F> && std::is_trivially_destructible_v<F>, "JobSystem::Fn: capture must be trivially copyable");
+            new (storage) F(f);
+            call = [] (void* p) { (*static_cast<F*>(p))(); };
+        }
+        inline void operator() ()
+        {
+            call(storage);
+        }
+
+    private:
+        alignas(std::max_align_t) unsigned char storage[inlineSize];
+        void (*call)(void*) = nullptr;
+    };
+
+    class Counter
+    {
+    public:
+        Counter () = default;
+        Counter (Counter& rhs) = delete;
+        Counter (Counter&& rhs) = delete;
+        inline bool done () const
+        {
+            return value.load(std::memory_order_acquire) == 0;
+        }
+
+    private:
+        friend class JobSystem;
+        std::atomic<uint32_t> value = 0;
+        std::mutex m;
+        std::vector<Job*> waiters;
+        std::exception_ptr error = nullptr;
+    };
+
+// workerCnt 0 means one per core minus the submitting thread;
+// pinWorkers binds worker i to core i + 1 (where supported), core 0 is left to main / render
+    JobSystem (uint32_t workerCnt, bool pinWorkers);
+    JobSystem (JobSystem& rhs) = delete;
+    JobSystem (JobSystem&& rhs) = delete;
+    ~JobSystem ();
+
+    inline uint32_t threadCount () const
+    {
+        return workers.size() + 1;
+    }
+// Index of the calling thread in [0, threadCount()), stable for the lifetime of the system
+    uint32_t threadIndex () const;
+
+// Schedule fn; signal (if given) is incremented now and decremented once fn has run;
+// with after, fn is held back until after reaches zero
+    void run (Fn fn, Counter* signal = nullptr, Counter* after = nullptr);
+// Execute jobs until c reaches zero, rethrows the first exception of a job signaling c
+    void wait (Counter& c);
+
+// fn(b, e) over [begin, end) in chunks of grain, returns when all chunks are done;
+// the chunks capture fn by reference, no allocation per chunk
+    template <typename F>
+    inline void parallelFor (size_t begin, size_t end, size_t grain, F&& fn)
+    {
+        if (begin >= end) return;
+        grain = std::max<size_t>(grain, 1);
+        Counter c;
+        for (size_t b = begin; b < end; b += grain) {
+            size_t e = std::min(end, b + grain);
+            auto* f = &fn;
+            run([f, b, e] { (*f)(b, e); }, &c);
+        }
+        wait(c);
+    }
+
+private:
+    struct Job {
+        Fn fn;
+        Counter* signal = nullptr;
+    };
+
+// Chase-Lev deque (Le, Pop, Cohen, Nardelli 2013), fixed capacity
+    class Deque
+    {
+    public:
+        static constexpr int64_t capacity = 4096;
+
+        inline bool push (Job* job)
+        {
+            int64_t b = bottom.load(std::memory_order_relaxed);
+            int64_t t = top.load(std::memory_order_acquire);
+            if (b - t >= capacity) return false;
+            buffer[b & (capacity - 1)].store(job, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_release);
+            bottom.store(b + 1, std::memory_order_relaxed);
+            return true;
+        }
+        inline Job* pop ()
+        {
+            int64_t b = bottom.load(std::memory_order_relaxed) - 1;
+            bottom.store(b, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            int64_t t = top.load(std::memory_order_relaxed);
+            if (t > b) {
+                bottom.store(b + 1, std::memory_order_relaxed);
+                return nullptr;
+            }
+            Job* job = buffer[b & (capacity - 1)].load(std::memory_order_relaxed);
+            if (t == b) {
+            // last element, race against thieves
+                if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+                    job = nullptr;
+                }
+                bottom.store(b + 1, std::memory_order_relaxed);
+            }
+            return job;
+        }
+        inline Job* steal ()
+        {
+            int64_t t = top.load(std::memory_order_acquire);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            int64_t b = bottom.load(std::memory_order_acquire);
+            if (t >= b) return nullptr;
+            Job* job = buffer[t & (capacity - 1)].load(std::memory_order_relaxed);
+            if (!top.compare_exchange_strong(t, t + 1, std::memory_order_seq_cst, std::memory_order_relaxed)) {
+                return nullptr;
+            }
+            return job;
+        }
+
+    private:
+        alignas(64) std::atomic<int64_t> top = 0;
+        alignas(64) std::atomic<int64_t> bottom = 0;
+        std::array<std::atomic<Job*>, capacity> buffer;
+    };
+
+// Per-thread state: the deque and a ring of job slots the thread allocates from.
+// A slot is reused after jobPoolSize allocations, so a thread must not have more
+// than jobPoolSize jobs outstanding.
+    static constexpr uint32_t jobPoolSize = 4096;
+    struct alignas(64) ThreadState {
+        Deque deque;
+        std::array<Job, jobPoolSize> jobs;
+        uint32_t nextJob = 0;
+    };
+
+    std::vector<std::unique_ptr<ThreadState>> threads;
+    std::vector<std::thread> workers;
+    std::atomic<bool> stop = false;
+// idle workers sleep on wakeCv; queuedJobs counts jobs sitting in deques
+    std::atomic<uint32_t> queuedJobs = 0;
+    std::atomic<uint32_t> sleepingWorkers = 0;
+    std::mutex wakeMutex;
+    std::condition_variable wakeCv;
+
+    Job* allocJob ();
+    void push (Job* job);
+    Job* find (uint32_t self);
+    void execute (Job* job);
+    void workerLoop (uint32_t idx);
+};
+
+#endif
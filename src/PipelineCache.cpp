@@ -0,0 +1,125 @@
+#include "PipelineCache.h"
+#include "utils.h"
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <format>
+#include <fstream>
+#include <iostream>
+#include <stdexcept>
+#include <fcntl.h>
+#include <unistd.h>
+
+void PipelineCache::init (VkDevice device, const VkPhysicalDeviceProperties& props, std::string path)
+{
+    this->device = device;
+    this->props = props;
+    this->path = path;
+// Step 1: Read the previous run's data, if any and if it was written by this device / driver
+    std::vector<char> data;
+    if (!path.empty()) {
+        std::ifstream file(path, std::ios::binary | std::ios::ate);
+        if (file.is_open()) {
+            data.resize(file.tellg());
+            file.seekg(0);
+            file.read(data.data(), data.size());
+            if (!file || !validate(data)) {
+                std::cerr << "[Warning] pipeline cache " << path << " is stale or corrupt, starting empty" << std::endl;
+                data.clear();
+            }
+        }
+    }
+// Step 2: Create the cache
+    {
+        VkPipelineCacheCreateInfo pipelineCacheCreateInfo;
+        auto& ci = pipelineCacheCreateInfo;
+        ci.sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO;
+        ci.pNext = nullptr;
+        ci.flags = 0;
+        ci.initialDataSize = data.size();
+        ci.pInitialData = data.empty() ? nullptr : data.data();
+        VkResult r = vkCreatePipelineCache(device, &ci, nullptr, &cache);
+        if (r != VK_SUCCESS) throw std::runtime_error(std::format("vkCreatePipelineCache: {}", (int)r));
+    }
+    loaded = data.size();
+    if (!path.empty()) {
+        logInfo(std::format("Pipeline cache: {} ({} bytes loaded)", path, loaded));
+    }
+}
+
+void PipelineCache::destroy ()
+{
+    if (cache == VK_NULL_HANDLE) return;
+    vkDestroyPipelineCache(device, cache, nullptr);
+    cache = VK_NULL_HANDLE;
+}
+
+bool PipelineCache::validate (const std::vector<char>& data) const
+{
+    VkPipelineCacheHeaderVersionOne header;
+    if (data.size() < sizeof(header)) return false;
+    std::memcpy(&header, data.data(), sizeof(header));
+    return header.headerSize >= sizeof(header) && header.headerSize <= data.size()
+        && header.headerVersion == VK_PIPELINE_CACHE_HEADER_VERSION_ONE
+        && header.vendorID == props.vendorID
+        && header.deviceID == props.deviceID
+        && std::memcmp(header.pipelineCacheUUID, props.pipelineCacheUUID, VK_UUID_SIZE) == 0;
+}
+
+bool PipelineCache::save ()
+{
+    if (cache == VK_NULL_HANDLE || path.empty()) return false;
+// Step 1: Fetch the data, the size may grow between the two calls if other threads still compile
+    std::vector<char> data;
+    size_t size = 0;
+    VkResult r;
+    do {
+        r = vkGetPipelineCacheData(device, cache, &size, nullptr);
+        if (r != VK_SUCCESS) break;
+        data.resize(size);
+        r = vkGetPipelineCacheData(device, cache, &size, data.data());
+    } while (r == VK_INCOMPLETE);
+    if (r != VK_SUCCESS) {
+        std::cerr << "[Warning] vkGetPipelineCacheData: " << (int)r << std::endl;
+        return false;
+    }
+    data.resize(size);
+// Step 2: Write a temporary file, sync it and rename it over the old cache (atomic on POSIX);
+//         without the fsync the rename may reach the disk before the data does
+    std::string tmpPath = path + ".tmp";
+    {
+        int fd = open(tmpPath.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        bool ok = fd >= 0;
+        for (size_t written = 0; ok && written < data.size(); ) {
+            ssize_t n = write(fd, data.data() + written, data.size() - written);
+            if (n < 0 && errno == EINTR) continue;
+            ok = n > 0;
+            written += ok ? n : 0;
+        }
+        ok = ok && fsync(fd) == 0;
+        if (fd >= 0 && close(fd) != 0) ok = false;
+        if (!ok) {
+            std::cerr << "[Warning] could not write pipeline cache " << tmpPath << std::endl;
+            std::remove(tmpPath.c_str());
+            return false;
+        }
+    }
+    if (std::rename(tmpPath.c_str(), path.c_str()) != 0) {
+        std::cerr << "[Warning] could not replace pipeline cache " << path << std::endl;
+        std::remove(tmpPath.c_str());
+        return false;
+    }
+// Step 3: Sync the directory so the rename itself is durable
+    {
+        size_t slash = path.find_last_of('/');
+        std::string dir = slash == std::string::npos ? "." : (slash == 0 ? "/" : path.substr(0, slash));
+        int fd = open(dir.c_str(), O_RDONLY | O_DIRECTORY);
+        if (fd < 0 || fsync(fd) != 0) {
+            std::cerr << "[Warning] could not sync directory " << dir << " of pipeline cache" << std::endl;
+        }
+        if (fd >= 0) close(fd);
+    }
+    logInfo(std::format("Pipeline cache: {} bytes saved to {}", data.size(), path));
+    return true;
+}
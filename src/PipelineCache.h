@@ -0,0 +1,50 @@
+#ifndef PIPELINECACHE_H
+#define PIPELINECACHE_H
+
+#include <vulkan/vulkan.h>
+#include <string>
+#include <vector>
+
+// VkPipelineCache persisted across runs.
+//
+// init() seeds the cache from a file written by an earlier run, but only if its
+// VkPipelineCacheHeaderVersionOne names this vendor, device and pipelineCacheUUID
+// (driver updates change the UUID); anything else starts empty. save() writes the
+// cache data next to the file, syncs it and renames it over the old one, so neither
+// a crash nor a power loss while saving leaves a truncated cache behind.
+//
+// get() is internally synchronized and may be shared by all threads.
+class PipelineCache
+{
+public:
+    PipelineCache () = default;
+    PipelineCache (PipelineCache& rhs) = delete;
+    PipelineCache (PipelineCache&& rhs) = delete;
+
+// empty path: in-memory cache only, nothing loaded or saved
+    void init (VkDevice device, const VkPhysicalDeviceProperties& props, std::string path);
+    void destroy ();
+// Writes the current data to path, true on success; failures are warnings only
+    bool save ();
+
+    inline VkPipelineCache get () const
+    {
+        return cache;
+    }
+// bytes accepted from disk at init, 0 on a cold start
+    inline size_t loadedSize () const
+    {
+        return loaded;
+    }
+
+private:
+    VkDevice device = VK_NULL_HANDLE;
+    VkPipelineCache cache = VK_NULL_HANDLE;
+    VkPhysicalDeviceProperties props;
+    std::string path;
+    size_t loaded = 0;
+
+    bool validate (const std::vector<char>& data) const;
+};
+
+#endif
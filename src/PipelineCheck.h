@@ -0,0 +1,53 @@
+#ifndef PIPELINECHECK_H
+#define PIPELINECHECK_H
+
+#include <format>
+#include <exception>
+#include "utils.h"
+#include "Config.h"
+#include "Headless.h"
+
+// --check-pipelines: headless regression check of the pipeline variants. Registering
+// the same (name, constants) again must compile nothing, and switching variants at
+// runtime must only rebind pipelines compiled at init.
+// Throws on failure, so main exits with 1; run by `make check`.
+inline void runPipelineCheck (Config& cfg)
+{
+    constexpr size_t framesPerVariant = 3;
+    cfg.headless = true;
+    Headless ctx(cfg);
+    Vulkan& vk = ctx.getVulkan();
+    for (size_t i = 0; i < framesPerVariant; ++i) {
+        ctx.render();
+    }
+    const PipelineRegistry& pipelines = vk.getPipelines();
+    uint64_t compiles = pipelines.compileCount();
+    size_t registered = pipelines.size();
+// Step 1: Same names and constants again
+    vk.registerPipelines();
+    if (pipelines.compileCount() != compiles || pipelines.size() != registered) {
+        throw std::runtime_error(std::format("pipeline check: registering again compiled {} and added {} pipelines",
+            pipelines.compileCount() - compiles, pipelines.size() - registered));
+    }
+// Step 2: Every variant is drawn with, none is compiled on the way
+    VkPipeline first = vk.getPipeline();
+    vk.toggleHueTint();
+    for (size_t i = 0; i < framesPerVariant; ++i) {
+        ctx.render();
+    }
+    VkPipeline tinted = vk.getPipeline();
+    vk.toggleRotate();
+    for (size_t i = 0; i < framesPerVariant; ++i) {
+        ctx.render();
+    }
+    if (tinted == first || vk.getPipeline() == tinted || vk.getPipeline() == first) {
+        throw std::runtime_error("pipeline check: switching variants did not switch pipelines");
+    }
+    if (pipelines.compileCount() != compiles) {
+        throw std::runtime_error(std::format("pipeline check: {} pipelines compiled by a variant switch",
+            pipelines.compileCount() - compiles));
+    }
+    logInfo(std::format("Pipeline check passed: {} pipelines, none compiled after init", registered));
+}
+
+#endif
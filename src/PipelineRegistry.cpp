@@ -0,0 +1,107 @@
+#include "PipelineRegistry.h"
+#include "Telemetry.h"
+#include "utils.h"
+
+#include <format>
+#include <stdexcept>
+
+void PipelineRegistry::init (VkDevice device, JobSystem& jobSystem, VkPipelineCache pipelineCache)
+{
+    this->device = device;
+    this->jobSystem = &jobSystem;
+    this->pipelineCache = pipelineCache;
+}
+
+void PipelineRegistry::destroy ()
+{
+    // a failed compilation has nothing to destroy, its error is of no interest any more
+    for (auto& entry : entries) {
+        try {
+            jobSystem->wait(entry.done);
+        } catch (std::exception&) {
+        }
+        VkPipeline pipeline = entry.pipeline.load(std::memory_order_acquire);
+        if (pipeline != VK_NULL_HANDLE) {
+            vkDestroyPipeline(device, pipeline, nullptr);
+        }
+    }
+    entries.clear();
+    variants.clear();
+}
+
+PipelineRegistry::Id PipelineRegistry::add (std::string name, const VkGraphicsPipelineCreateInfo& ci, std::span<const uint32_t> constants)
+{
+    auto key = std::make_pair(name, std::vector<uint32_t>(constants.begin(), constants.end()));
+    auto it = variants.find(key);
+    if (it != variants.end()) return it->second;
+    for (uint32_t i = 0; i < ci.stageCount && !constants.empty(); ++i) {
+        if (ci.pStages[i].pSpecializationInfo != nullptr) {
+            throw std::runtime_error(std::format("pipeline {}: stage {} has its own specialization info", name, i));
+        }
+    }
+    Id id = static_cast<Id>(entries.size());
+    auto& entry = entries.emplace_back();
+    entry.name = std::move(name);
+    entry.ci = ci;
+    entry.stages.assign(ci.pStages, ci.pStages + ci.stageCount);
+    entry.ci.pStages = entry.stages.data();
+    if (!constants.empty()) {
+        entry.constants = key.second;
+        entry.mapEntries.resize(constants.size());
+        for (uint32_t i = 0; i < constants.size(); ++i) {
+            entry.mapEntries[i] = VkSpecializationMapEntry { i, i * uint32_t(sizeof(uint32_t)), sizeof(uint32_t) };
+        }
+        entry.specialization.mapEntryCount = entry.mapEntries.size();
+        entry.specialization.pMapEntries = entry.mapEntries.data();
+        entry.specialization.dataSize = entry.constants.size() * sizeof(uint32_t);
+        entry.specialization.pData = entry.constants.data();
+        for (auto& stage : entry.stages) {
+            stage.pSpecializationInfo = &entry.specialization;
+        }
+        // variants show up as name[c0,c1,...] in logs
+        entry.name += "[";
+        for (uint32_t i = 0; i < constants.size(); ++i) {
+            entry.name += std::format("{}{}", i > 0 ? "," : "", constants[i]);
+        }
+        entry.name += "]";
+    }
+    variants.emplace(std::move(key), id);
+    return id;
+}
+
+void PipelineRegistry::compile ()
+{
+    uint32_t cnt = 0;
+    for (auto& entry : entries) {
+        if (entry.submitted) continue;
+        entry.submitted = true;
+        ++cnt;
+        ++compiles;
+        jobSystem->run([this, &entry] {
+            auto t = Telemetry::now();
+            VkPipeline pipeline;
+            VkResult r = vkCreateGraphicsPipelines(device, pipelineCache, 1, &entry.ci, nullptr, &pipeline);
+            if (r != VK_SUCCESS) throw std::runtime_error(std::format("vkCreateGraphicsPipelines ({}): {}", entry.name, (int)r));
+            entry.pipeline.store(pipeline, std::memory_order_release);
+            logInfo(std::format("Pipeline {} compiled in {:.2f} ms", entry.name, Telemetry::since(t) / 1e6));
+        }, &entry.done);
+    }
+    if (cnt > 0) {
+        logInfo(std::format("Compiling {} pipelines on {} threads", cnt, jobSystem->threadCount()));
+    }
+}
+
+VkPipeline PipelineRegistry::wait (Id id)
+{
+    auto& entry = entries[id];
+    if (!entry.submitted) throw std::runtime_error(std::format("pipeline {} waited for before compile()", entry.name));
+    jobSystem->wait(entry.done);
+    return entry.pipeline.load(std::memory_order_acquire);
+}
+
+void PipelineRegistry::waitAll ()
+{
+    for (Id id = 0; id < entries.size(); ++id) {
+        wait(id);
+    }
+}
@@ -0,0 +1,100 @@
+#ifndef PIPELINEREGISTRY_H
+#define PIPELINEREGISTRY_H
+
+#include <vulkan/vulkan.h>
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <map>
+#include <span>
+#include <string>
+#include <vector>
+#include "JobSystem.h"
+
+// Every pipeline the renderer uses, compiled concurrently on the job system.
+//
+// Pipelines are described up front with add(); compile() then starts one job per
+// pipeline not compiled yet and returns at once. Callers ask for exactly the
+// pipelines they are about to use: get() never blocks (VK_NULL_HANDLE while still
+// compiling), wait() helps the job system until that one pipeline is ready, so the
+// first frame starts as soon as its own pipelines are done, not all of them.
+// All jobs compile against the one shared, internally synchronized VkPipelineCache,
+// which is what gets persisted (see PipelineCache.h).
+//
+// Variants: the same description registered with different specialization constants
+// is a separate pipeline. Constant i (constant_id = i in GLSL) gets constants[i], as
+// a 32-bit value (bool / int / uint / float bits); the same values apply to every
+// stage, stages ignore IDs they don't declare. Registering a name with constants it
+// already has returns the existing pipeline, so variants are compiled once.
+//
+// add() / compile() / wait() / destroy(): one owning thread at a time. Ownership may
+// move between threads when the handoff happens-before the new owner's first call:
+// with a window the main thread adds and compiles during init, then starting the
+// render thread hands the registry (and the job system's outside-thread slot) to it
+// for wait() in render(); joining it hands both back for destroy(). Headless runs
+// keep everything on the main thread.
+// get() / ready(): any thread.
+class PipelineRegistry
+{
+public:
+    using Id = uint32_t;
+
+    PipelineRegistry () = default;
+    PipelineRegistry (PipelineRegistry& rhs) = delete;
+    PipelineRegistry (PipelineRegistry&& rhs) = delete;
+
+    void init (VkDevice device, JobSystem& jobSystem, VkPipelineCache pipelineCache);
+// Waits for pending compilations, then destroys all pipelines
+    void destroy ();
+
+// The stages and constants are copied; everything else ci points to (states, layout,
+// render pass, shader modules) must stay valid until the pipeline is ready.
+    Id add (std::string name, const VkGraphicsPipelineCreateInfo& ci, std::span<const uint32_t> constants = {});
+    void compile ();
+
+    inline bool ready (Id id) const
+    {
+        return entries[id].pipeline.load(std::memory_order_acquire) != VK_NULL_HANDLE;
+    }
+    inline VkPipeline get (Id id) const
+    {
+        return entries[id].pipeline.load(std::memory_order_acquire);
+    }
+// Rethrows the compile error of this pipeline, if any
+    VkPipeline wait (Id id);
+    void waitAll ();
+
+    inline size_t size () const
+    {
+        return entries.size();
+    }
+// compilations started so far, for checks that some path compiles nothing
+    inline uint64_t compileCount () const
+    {
+        return compiles;
+    }
+
+private:
+    struct Entry {
+        std::string name;
+        VkGraphicsPipelineCreateInfo ci;
+        std::vector<VkPipelineShaderStageCreateInfo> stages;
+        std::vector<uint32_t> constants;
+        std::vector<VkSpecializationMapEntry> mapEntries;
+        VkSpecializationInfo specialization;
+        std::atomic<VkPipeline> pipeline = VK_NULL_HANDLE;
+        JobSystem::Counter done;
+        bool submitted = false;
+    };
+
+    VkDevice device = VK_NULL_HANDLE;
+    JobSystem* jobSystem = nullptr;
+    VkPipelineCache pipelineCache = VK_NULL_HANDLE;
+// deque: entries never move, jobs keep pointers to them
+    std::deque<Entry> entries;
+    uint64_t compiles = 0;
+// (name, constants) -> entry
+    std::map<std::pair<std::string, std::vector<uint32_t>>, Id> variants;
+};
+
+#endif
@@ -0,0 +1,42 @@
+#ifndef RESIZECHECK_H
+#define RESIZECHECK_H
+
+#include <format>
+#include <exception>
+#include "utils.h"
+#include "Config.h"
+#include "Headless.h"
+
+// --check-resize: headless regression check that a resize rebuilds the render
+// targets without compiling a single pipeline (viewport and scissor are dynamic).
+// Throws on failure, so main exits with 1; run by `make check`.
+inline void runResizeCheck (Config& cfg)
+{
+    constexpr size_t framesPerSize = 3;
+    cfg.headless = true;
+    Headless ctx(cfg);
+    Vulkan& vk = ctx.getVulkan();
+    for (size_t i = 0; i < framesPerSize; ++i) {
+        ctx.render();
+    }
+    VkExtent2D before = vk.getExtent();
+    uint64_t compiles = vk.getPipelines().compileCount();
+// the next render() goes through rebuildSwapchain()
+    vk.resize(before.width / 2 + 1, before.height / 2 + 1);
+    for (size_t i = 0; i < framesPerSize; ++i) {
+        ctx.render();
+    }
+    VkExtent2D after = vk.getExtent();
+    if (after.width != before.width / 2 + 1 || after.height != before.height / 2 + 1) {
+        throw std::runtime_error(std::format("resize check: extent is {} x {}, expected {} x {}",
+            after.width, after.height, before.width / 2 + 1, before.height / 2 + 1));
+    }
+    if (vk.getPipelines().compileCount() != compiles) {
+        throw std::runtime_error(std::format("resize check: {} pipelines compiled by a resize",
+            vk.getPipelines().compileCount() - compiles));
+    }
+    logInfo(std::format("Resize check passed: {} x {} -> {} x {}, no pipeline compiled",
+        before.width, before.height, after.width, after.height));
+}
+
+#endif
@@ -0,0 +1,74 @@
+#ifndef SCENE_H
+#define SCENE_H
+
+#include <array>
+#include <cstdint>
+#include <vector>
+#include <string>
+#include <format>
+#include <exception>
+
+// Built-in scenes, selected with the "scene" config key or --scene.
+// All of them draw the triangle of shader/triangle.*, they differ in load:
+// - triangle  : a single draw
+// - overdraw  : one draw, many instances on top of each other (fill bound)
+// - drawcalls : many single-instance draws (CPU recording / submission bound)
+struct SceneDesc
+{
+    const char* name;
+    uint32_t drawCnt;
+    uint32_t instanceCnt;
+};
+
+inline constexpr std::array<SceneDesc, 3> builtinScenes = {{
+    { "triangle", 1, 1 },
+    { "overdraw", 1, 1000 },
+    { "drawcalls", 10000, 1 },
+}};
+
+// Draw lists are split into render buckets, recorded and cached independently
+// (see BucketCache.h) and drawn in this order
+enum RenderBucket
+{
+    StaticWorld,
+    Dynamic,
+    Ui,
+    BucketCount
+};
+inline constexpr std::array<const char*, BucketCount> bucketNames = { "staticWorld", "dynamic", "ui" };
+
+// One entry of a draw list, arguments of vkCmdDraw
+struct DrawCmd
+{
+    uint32_t vertexCnt;
+    uint32_t instanceCnt;
+    uint32_t firstVertex;
+    uint32_t firstInstance;
+};
+
+inline const SceneDesc& findScene (const std::string& name)
+{
+    for (auto& el : builtinScenes) {
+        if (name == el.name) return el;
+    }
+    throw std::runtime_error(std::format("unknown scene {}", name));
+}
+
+// Built-in scenes are static, the whole list goes to StaticWorld
+inline std::vector<DrawCmd> buildDrawList (const SceneDesc& scene)
+{
+    return std::vector<DrawCmd>(scene.drawCnt, DrawCmd { 3, scene.instanceCnt, 0, 0 });
+}
+
+// FNV-1a over the draw arguments, identifies a bucket's content
+inline uint64_t hashDraws (const DrawCmd* draws, size_t cnt)
+{
+    uint64_t h = 0xcbf29ce484222325ull;
+    auto bytes = reinterpret_cast<const unsigned char*>(draws);
+    for (size_t i = 0; i < cnt * sizeof(DrawCmd); ++i) {
+        h = (h ^ bytes[i]) * 0x100000001b3ull;
+    }
+    return h;
+}
+
+#endif
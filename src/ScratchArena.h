@@ -0,0 +1,181 @@
+#ifndef SCRATCHARENA_H
+#define SCRATCHARENA_H
+
+#include <algorithm>
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <initializer_list>
+#include <format>
+#include <exception>
+#include <type_traits>
+
+// Bump allocator for short-lived host arrays: create infos, enumeration results,
+// clear values. Its buffer is allocated once; a Scope marks the head when it is
+// constructed and rewinds to the mark when it is destroyed, so everything a routine
+// took from the arena is gone at its end without touching the heap.
+// Allocations are aligned to at least alignof(std::max_align_t) (SPIR-V needs 4).
+// Render thread only.
+class ScratchArena
+{
+public:
+    class Scope
+    {
+    public:
+        explicit Scope (ScratchArena& arena)
+        : arena (arena),
+          mark (arena.head)
+        {
+        }
+        ~Scope ()
+        {
+            arena.head = mark;
+        }
+        Scope (Scope& rhs) = delete;
+        Scope (Scope&& rhs) = delete;
+
+    private:
+        ScratchArena& arena;
+        size_t mark;
+    };
+
+    explicit ScratchArena (size_t capacity)
+    : buffer (new std::byte[capacity]),
+      capacity (capacity)
+    {
+    }
+    ScratchArena (ScratchArena& rhs) = delete;
+    ScratchArena (ScratchArena&& rhs) = delete;
+
+    inline void* alloc (size_t size, size_t alignment)
+    {
+        alignment = std::max(alignment, alignof(std::max_align_t));
+        size_t offset = (head + alignment - 1) / alignment * alignment;
+        if (offset + size > capacity) {
+            throw std::runtime_error(std::format("ScratchArena: {} bytes requested, {} of {} in use", size, head, capacity));
+        }
+        head = offset + size;
+        highWater = std::max(highWater, head);
+        return buffer.get() + offset;
+    }
+    inline size_t used () const
+    {
+        return head;
+    }
+// most bytes ever in use at once, to size the arena
+    inline size_t peak () const
+    {
+        return highWater;
+    }
+
+private:
+    std::unique_ptr<std::byte[]> buffer;
+    size_t capacity;
+    size_t head = 0;
+    size_t highWater = 0;
+};
+
+// Fixed-capacity vector living in a ScratchArena, for trivially destructible
+// element types (Vulkan structs, handles). Storage is taken from the arena on
+// construction and given back with the enclosing Scope; elements added by
+// resize() are value-initialized, i.e. zeroed.
+template <typename T>
+class ScratchVector
+{
+    static_assert(std::is_trivially_destructible_v<T>, "ScratchVector elements are never destroyed");
+
+public:
+    ScratchVector (ScratchArena& arena, size_t capacity)
+    : ptr (static_cast<T*>(arena.alloc(sizeof(T) * capacity, alignof(T)))),
+      cap (capacity)
+    {
+    }
+    ScratchVector (ScratchArena& arena, std::initializer_list<T> init)
+    : ScratchVector (arena, init.size())
+    {
+        for (auto& el : init) {
+            push_back(el);
+        }
+    }
+    ScratchVector (ScratchVector& rhs) = delete;
+    ScratchVector (ScratchVector&& rhs) = default;
+
+    inline void resize (size_t n)
+    {
+        checkCapacity(n);
+        for (size_t i = cnt; i < n; ++i) {
+            new (ptr + i) T();
+        }
+        cnt = n;
+    }
+    inline void push_back (const T& value)
+    {
+        checkCapacity(cnt + 1);
+        new (ptr + cnt) T(value);
+        ++cnt;
+    }
+    inline void clear ()
+    {
+        cnt = 0;
+    }
+    inline T& operator[] (size_t i)
+    {
+        return ptr[i];
+    }
+    inline const T& operator[] (size_t i) const
+    {
+        return ptr[i];
+    }
+    inline T& back ()
+    {
+        return ptr[cnt - 1];
+    }
+    inline T* data ()
+    {
+        return ptr;
+    }
+    inline const T* data () const
+    {
+        return ptr;
+    }
+    inline size_t size () const
+    {
+        return cnt;
+    }
+    inline size_t capacity () const
+    {
+        return cap;
+    }
+    inline bool empty () const
+    {
+        return cnt == 0;
+    }
+    inline T* begin ()
+    {
+        return ptr;
+    }
+    inline T* end ()
+    {
+        return ptr + cnt;
+    }
+    inline const T* begin () const
+    {
+        return ptr;
+    }
+    inline const T* end () const
+    {
+        return ptr + cnt;
+    }
+
+private:
+    T* ptr;
+    size_t cap;
+    size_t cnt = 0;
+
+    inline void checkCapacity (size_t n)
+    {
+        if (n > cap) throw std::runtime_error(std::format("ScratchVector: capacity {} exceeded", cap));
+    }
+};
+
+#endif
@@ -2,11 +2,13 @@
 #include "utils.h"
 
 #include <exception>
+#include <thread>
 
 Sdl::Sdl (Config& cfg)
 : windowTitle (cfg.title),
   windowWidth (cfg.windowWidth),
-  windowHeight (cfg.windowHeight)
+  windowHeight (cfg.windowHeight),
+  backgroundFrameInterval (cfg.backgroundFrameCap == 0 ? 0 : 1000000 / cfg.backgroundFrameCap)
 {
     if (SDL_Init(SDL_INIT_VIDEO | SDL_INIT_AUDIO) != 0) {
         throw std::runtime_error(std::format("SDL_Init: {}", SDL_GetError()));
@@ -23,7 +25,8 @@ Sdl::Sdl (Config& cfg)
                SDL_WINDOWPOS_CENTERED,
                windowWidth, windowHeight,
                SDL_WINDOW_VULKAN |
-               SDL_WINDOW_SHOWN
+               SDL_WINDOW_SHOWN |
+               SDL_WINDOW_RESIZABLE
              );
     if (window == nullptr) {
         throw std::runtime_error(std::format("SDL_CreateWindow: {}", SDL_GetError()));
@@ -45,22 +48,181 @@ Sdl::Sdl (Config& cfg)
         throw std::runtime_error("SDL_Vulkan_CreateSurface failed");
     }
 
+    {
+        int w = 0, h = 0;
+        SDL_Vulkan_GetDrawableSize(window, &w, &h);
+        vulkanCtx->resize(w, h);
+    }
     vulkanCtx->initGraphics(s);
 }
 
 Sdl::~Sdl ()
 {
+    if (renderThread.joinable()) {
+        SDL_Event quit;
+        quit.type = SDL_QUIT;
+        while (renderThreadRunning && !renderEvents.push(quit)) {
+            std::this_thread::yield();
+        }
+        renderThread.join();
+    }
+    // Vulkan objects (surface included) go before the window and the library
+    vulkanCtx.reset();
     SDL_DestroyWindow(window);
 	SDL_Vulkan_UnloadLibrary();
 	SDL_Quit();
 	window = nullptr;
 }
 
+// Main thread: window queries stay here, so the drawable size is looked up
+// now and carried in data1 / data2 of window events
+void Sdl::forwardEvent (SDL_Event& e)
+{
+    if (e.type == SDL_WINDOWEVENT) {
+        int w = 0, h = 0;
+        SDL_Vulkan_GetDrawableSize(window, &w, &h);
+        e.window.data1 = w;
+        e.window.data2 = h;
+    }
+    // only full if the render thread stalls, never drop events (quit in particular)
+    while (renderThreadRunning && !renderEvents.push(e)) {
+        std::this_thread::yield();
+    }
+}
+
+// Render thread (or the caller of eventLoop in single-threaded stepping)
+void Sdl::handleRenderEvent (const SDL_Event& e)
+{
+    if (e.type == SDL_WINDOWEVENT) {
+        bool wasIdle = windowState.idle();
+        switch (e.window.event) {
+            case SDL_WINDOWEVENT_SHOWN:
+            case SDL_WINDOWEVENT_EXPOSED:
+                windowState.shown = true;
+                break;
+            case SDL_WINDOWEVENT_HIDDEN:
+                windowState.shown = false;
+                break;
+            case SDL_WINDOWEVENT_FOCUS_GAINED:
+                windowState.focused = true;
+                break;
+            case SDL_WINDOWEVENT_FOCUS_LOST:
+                windowState.focused = false;
+                break;
+        // minimize reports a zero drawable size on some platforms, the renderer then skips frames
+            case SDL_WINDOWEVENT_MINIMIZED:
+                windowState.minimized = true;
+                vulkanCtx->resize(e.window.data1, e.window.data2);
+                break;
+            case SDL_WINDOWEVENT_RESTORED:
+            case SDL_WINDOWEVENT_MAXIMIZED:
+                windowState.minimized = false;
+                vulkanCtx->resize(e.window.data1, e.window.data2);
+                break;
+            case SDL_WINDOWEVENT_SIZE_CHANGED:
+                vulkanCtx->resize(e.window.data1, e.window.data2);
+                break;
+            default: break;
+        }
+        if (wasIdle != windowState.idle()) {
+            logInfo(std::format("Window {}", windowState.idle() ? "idle, throttling" : "active"));
+            // time spent idle is not a frame time
+            vulkanCtx->resetFrameTiming();
+        }
+    } else if (e.type == SDL_KEYDOWN && e.key.repeat == 0) {
+    // R / H switch the triangle's pipeline variant (rotation, hue tint)
+        switch (e.key.keysym.sym) {
+            case SDLK_r: vulkanCtx->toggleRotate(); break;
+            case SDLK_h: vulkanCtx->toggleHueTint(); break;
+            default: break;
+        }
+    }
+}
+
+void Sdl::renderLoop ()
+{
+    try {
+        bool quit = false;
+        auto nextFrameTime = std::chrono::steady_clock::now();
+        while (true) {
+            SDL_Event e;
+            while (renderEvents.pop(e)) {
+                if (e.type == SDL_QUIT) {
+                    quit = true;
+                    break;
+                }
+                handleRenderEvent(e);
+            }
+            if (quit) break;
+        // idle: nothing visible means nothing to render, only keep an eye on the queue;
+        //       visible but unfocused renders at backgroundFrameInterval
+            if (!windowState.visible()) {
+                std::this_thread::sleep_for(idlePollInterval);
+                continue;
+            }
+            if (!windowState.focused && backgroundFrameInterval.count() > 0) {
+                std::this_thread::sleep_until(nextFrameTime);
+                nextFrameTime = std::max(nextFrameTime + backgroundFrameInterval, std::chrono::steady_clock::now());
+            }
+            vulkanCtx->render();
+        }
+    } catch (...) {
+        renderThreadError = std::current_exception();
+    }
+    // release pairs with the acquire load in run(), renderThreadError is visible after it
+    renderThreadRunning.store(false, std::memory_order_release);
+}
+
+void Sdl::run ()
+{
+    renderThreadRunning = true;
+// from here on the render thread owns the Vulkan context: starting it hands over the
+// pipeline registry and the job system's outside-thread slot used during init
+    renderThread = std::thread(&Sdl::renderLoop, this);
+    logInfo("Render thread started");
+    // Shutdown handshake: SDL_QUIT is forwarded like any other event, the render
+    // thread finishes its frame and exits; if it dies on its own we stop pumping
+    while (running && renderThreadRunning.load(std::memory_order_acquire)) {
+        if (SDL_WaitEventTimeout(&ev, 100)) {
+            do {
+                if (ev.type == SDL_QUIT) {
+                    running = false;
+                }
+                forwardEvent(ev);
+            } while (running && SDL_PollEvent(&ev));
+        }
+    }
+    renderThread.join();
+    logInfo("Render thread stopped");
+    if (renderThreadError) {
+        std::rethrow_exception(renderThreadError);
+    }
+}
+
 void Sdl::eventLoop ()
 {
-    while (SDL_PollEvent(&ev)) {
+    auto handle = [this] () {
         if (ev.type == SDL_QUIT) {
             running = false;
+        } else if (ev.type == SDL_WINDOWEVENT) {
+            int w = 0, h = 0;
+            SDL_Vulkan_GetDrawableSize(window, &w, &h);
+            ev.window.data1 = w;
+            ev.window.data2 = h;
+            handleRenderEvent(ev);
+        } else if (ev.type == SDL_KEYDOWN) {
+            handleRenderEvent(ev);
         }
+    };
+    // idle: block for events instead of spinning through render(), the wait doubles as frame cap
+    if (windowState.idle()) {
+        // SDL waits in whole ms, round up so the cap is never exceeded
+        auto timeout = windowState.visible() ? std::chrono::ceil<std::chrono::milliseconds>(backgroundFrameInterval) : idlePollInterval;
+        if (timeout.count() > 0 && SDL_WaitEventTimeout(&ev, timeout.count())) {
+            handle();
+        }
+    }
+    while (SDL_PollEvent(&ev)) {
+        handle();
     }
 }
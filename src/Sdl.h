@@ -6,7 +6,12 @@
 #include <string>
 #include <vector>
 #include <memory>
+#include <thread>
+#include <atomic>
+#include <exception>
+#include <chrono>
 #include "Vulkan.h"
+#include "SpscQueue.h"
 
 class Sdl
 {
@@ -20,15 +25,48 @@ private:
 
     SDL_Event ev;
 
+// Tracked from SDL_WINDOWEVENT by whichever thread handles render events
+    struct WindowState {
+        bool shown = true;
+        bool minimized = false;
+        bool focused = true;
+        inline bool visible () const { return shown && !minimized; }
+        inline bool idle () const { return !visible() || !focused; }
+    } windowState;
+// while idle: frame interval when visible but unfocused (0 = uncapped), poll interval otherwise
+// (microseconds: caps above 1000 or not dividing 1000 stay exact)
+    std::chrono::microseconds backgroundFrameInterval;
+    static constexpr std::chrono::milliseconds idlePollInterval = std::chrono::milliseconds(100);
+
+// Render thread: events are pumped on the main thread (SDL requires it) and
+// forwarded through renderEvents, Vulkan::render() only runs on renderThread
+    SpscQueue<SDL_Event, 1024> renderEvents;
+    std::thread renderThread;
+    std::atomic<bool> renderThreadRunning = false;
+    std::exception_ptr renderThreadError = nullptr;
+
+    void forwardEvent (SDL_Event& e);
+    void handleRenderEvent (const SDL_Event& e);
+    void renderLoop ();
+
 public:
     bool running = true;
 
     Sdl (Config& cfg);
     ~Sdl ();
+// Pump events on this thread and render on a dedicated one until quit
+    void run ();
+// Single-threaded stepping, handles pending events then render() draws one frame
     void eventLoop ();
     inline void render()
     {
-        vulkanCtx->render();
+        if (windowState.visible()) {
+            vulkanCtx->render();
+        }
+    }
+    inline Vulkan& getVulkan ()
+    {
+        return *vulkanCtx;
     }
 };
 
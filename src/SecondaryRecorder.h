@@ -0,0 +1,81 @@
+#ifndef SECONDARYRECORDER_H
+#define SECONDARYRECORDER_H
+
+#include <vulkan/vulkan.h>
+#include <vector>
+#include <format>
+#include <exception>
+
+// Secondary command buffers for parallel recording.
+// One transient command pool per (recording thread, frame in flight): a pool is
+// only ever touched by its own thread while recording, and reset as a whole by
+// the render thread once that frame's fence has signaled. Buffers allocated from
+// a pool are kept and handed out again after the reset.
+class SecondaryRecorder
+{
+public:
+    inline void init (VkDevice device, uint32_t queueFamilyIndex, uint32_t threadCnt, uint32_t frameCnt)
+    {
+        slots.resize(threadCnt * frameCnt);
+        this->frameCnt = frameCnt;
+        for (auto& slot : slots) {
+            VkCommandPoolCreateInfo commandPoolCreateInfo;
+            auto& ci = commandPoolCreateInfo;
+            ci.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+            ci.pNext = nullptr;
+            ci.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+            ci.queueFamilyIndex = queueFamilyIndex;
+            VkResult r = vkCreateCommandPool(device, &ci, nullptr, &(slot.pool));
+            if (r != VK_SUCCESS) throw std::runtime_error(std::format("vkCreateCommandPool: {}", (int)r));
+        }
+    }
+    inline void destroy (VkDevice device)
+    {
+        for (auto& slot : slots) {
+            vkDestroyCommandPool(device, slot.pool, nullptr);
+        }
+        slots.clear();
+    }
+
+// Render thread, after the frame's fence has signaled
+    inline void reset (VkDevice device, uint32_t frame)
+    {
+        for (uint32_t i = frame; i < slots.size(); i += frameCnt) {
+            auto& slot = slots[i];
+            if (slot.used == 0) continue;
+            vkResetCommandPool(device, slot.pool, 0);
+            slot.used = 0;
+        }
+    }
+// Recording thread `thread` only, returns a buffer in initial state
+    inline VkCommandBuffer acquire (VkDevice device, uint32_t thread, uint32_t frame)
+    {
+        auto& slot = slots[thread * frameCnt + frame];
+        if (slot.used == slot.buffers.size()) {
+            VkCommandBufferAllocateInfo commandBufferAllocateInfo;
+            auto& ai = commandBufferAllocateInfo;
+            ai.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+            ai.pNext = nullptr;
+            ai.commandPool = slot.pool;
+            ai.level = VK_COMMAND_BUFFER_LEVEL_SECONDARY;
+            ai.commandBufferCount = 1;
+            VkCommandBuffer cb;
+            VkResult r = vkAllocateCommandBuffers(device, &ai, &cb);
+            if (r != VK_SUCCESS) throw std::runtime_error(std::format("vkAllocateCommandBuffers: {}", (int)r));
+            slot.buffers.push_back(cb);
+        }
+        return slot.buffers[slot.used++];
+    }
+
+private:
+    struct Slot {
+        VkCommandPool pool = VK_NULL_HANDLE;
+        std::vector<VkCommandBuffer> buffers;
+        size_t used = 0;
+    };
+// index: thread * frameCnt + frame
+    std::vector<Slot> slots;
+    uint32_t frameCnt = 0;
+};
+
+#endif
@@ -0,0 +1,63 @@
+#ifndef SIMCLOCK_H
+#define SIMCLOCK_H
+
+#include <chrono>
+#include <cstdint>
+#include <algorithm>
+
+// Fixed-timestep simulation clock, decoupled from the render rate.
+// Each frame advance() turns elapsed wall time into a number of fixed steps to
+// simulate; the remainder is carried over and exposed as alpha() for
+// interpolating between the last two simulated states. At most maxCatchUpSteps
+// are run per frame, time beyond that is dropped so a slow machine slows the
+// simulation down instead of spiraling.
+class SimClock
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    SimClock (uint32_t rateHz, uint32_t maxCatchUpSteps)
+    : step (std::chrono::nanoseconds(1000000000ull / rateHz)),
+      maxCatchUpSteps (maxCatchUpSteps)
+    {}
+
+    inline uint32_t advance ()
+    {
+        auto t = Clock::now();
+        if (lastTime == Clock::time_point()) {
+            lastTime = t;
+        }
+        accumulator += t - lastTime;
+        lastTime = t;
+        uint32_t steps = static_cast<uint32_t>(accumulator / step);
+        if (steps > maxCatchUpSteps) {
+            steps = maxCatchUpSteps;
+            accumulator = step * steps;
+        }
+        accumulator -= step * steps;
+        stepCnt += steps;
+        return steps;
+    }
+// fraction of a step elapsed since the last simulated state, in [0, 1)
+    inline float alpha () const
+    {
+        return std::chrono::duration<float>(accumulator) / std::chrono::duration<float>(step);
+    }
+    inline double stepSeconds () const
+    {
+        return std::chrono::duration<double>(step).count();
+    }
+    inline uint64_t steps () const
+    {
+        return stepCnt;
+    }
+
+private:
+    Clock::duration step;
+    uint32_t maxCatchUpSteps;
+    Clock::duration accumulator = Clock::duration::zero();
+    Clock::time_point lastTime;
+    uint64_t stepCnt = 0;
+};
+
+#endif
@@ -0,0 +1,40 @@
+#ifndef SIMULATION_H
+#define SIMULATION_H
+
+#include <cmath>
+
+// Scene state advanced in fixed steps by SimClock. Only prev / curr are kept,
+// the renderer sees interpolate(alpha) between them.
+class Simulation
+{
+public:
+    struct State {
+        double time = 0.0;
+    // background hue in [0, 1), cycles once every huePeriod seconds
+        float hue = 0.0f;
+    };
+
+    inline void step (double dt)
+    {
+        prev = curr;
+        curr.time += dt;
+        curr.hue = static_cast<float>(std::fmod(curr.time / huePeriod, 1.0));
+    }
+    inline State interpolate (float alpha) const
+    {
+        State s;
+        s.time = prev.time + (curr.time - prev.time) * alpha;
+    // take the short way around when hue wraps from ~1 back to 0
+        float dh = curr.hue - prev.hue;
+        if (dh < -0.5f) dh += 1.0f;
+        s.hue = prev.hue + dh * alpha;
+        if (s.hue >= 1.0f) s.hue -= 1.0f;
+        return s;
+    }
+
+private:
+    static constexpr double huePeriod = 10.0;
+    State prev, curr;
+};
+
+#endif
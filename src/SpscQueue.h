@@ -0,0 +1,53 @@
+#ifndef SPSCQUEUE_H
+#define SPSCQUEUE_H
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <new>
+
+// Bounded lock-free single-producer / single-consumer queue.
+// Exactly one thread may push and exactly one (other) thread may pop.
+// Capacity must be a power of two; one slot is never used to tell full from empty.
+template <typename T, size_t Capacity>
+class SpscQueue
+{
+    static_assert((Capacity & (Capacity - 1)) == 0, "SpscQueue capacity must be a power of two");
+
+public:
+    SpscQueue () = default;
+    SpscQueue (SpscQueue& rhs) = delete;
+    SpscQueue (SpscQueue&& rhs) = delete;
+
+// Producer side, false if the queue is full
+    inline bool push (const T& item)
+    {
+        size_t t = tail.load(std::memory_order_relaxed);
+        size_t next = (t + 1) & (Capacity - 1);
+        if (next == head.load(std::memory_order_acquire)) {
+            return false;
+        }
+        slots[t] = item;
+        tail.store(next, std::memory_order_release);
+        return true;
+    }
+// Consumer side, false if the queue is empty
+    inline bool pop (T& item)
+    {
+        size_t h = head.load(std::memory_order_relaxed);
+        if (h == tail.load(std::memory_order_acquire)) {
+            return false;
+        }
+        item = slots[h];
+        head.store((h + 1) & (Capacity - 1), std::memory_order_release);
+        return true;
+    }
+
+private:
+// head and tail on their own cache lines, producer and consumer don't false-share
+    alignas(64) std::atomic<size_t> head = 0;
+    alignas(64) std::atomic<size_t> tail = 0;
+    std::array<T, Capacity> slots;
+};
+
+#endif
@@ -0,0 +1,143 @@
+#include "Telemetry.h"
+#include "utils.h"
+
+#include <algorithm>
+#include <format>
+#include <exception>
+#include <iostream>
+
+Telemetry::Telemetry (Config& cfg)
+: reportInterval (std::chrono::seconds(cfg.telemetryInterval)),
+  lastReportTime (Clock::now())
+{
+    if (!cfg.telemetryCsv.empty()) {
+        csvFile.open(cfg.telemetryCsv, std::ios::out | std::ios::trunc);
+        if (!csvFile.is_open()) {
+            throw std::runtime_error(std::format("could not open telemetry csv at {}", cfg.telemetryCsv));
+        }
+        csvFile << "frame";
+        for (uint32_t m = 0; m < MetricCount; ++m) {
+            csvFile << "," << metricNames[m] << "Ns";
+        }
+        csvFile << "\n";
+        logInfo(std::format("Telemetry writes csv to {}", cfg.telemetryCsv));
+        csvWriter = std::thread(&Telemetry::csvLoop, this);
+    }
+}
+
+Telemetry::~Telemetry ()
+{
+    report();
+    if (csvWriter.joinable()) {
+        {
+            std::lock_guard<std::mutex> lock(csvMutex);
+            csvStop = true;
+        }
+        csvCv.notify_one();
+        csvWriter.join();
+    // the rows pushed since the writer's last pass
+        flushCsv();
+    }
+}
+
+Telemetry::Summary Telemetry::summarize (std::vector<uint64_t>& values)
+{
+    Summary s;
+    s.cnt = values.size();
+    if (s.cnt == 0) return s;
+    std::sort(values.begin(), values.end());
+// nearest-rank percentile
+    auto pct = [&values] (double p) {
+        size_t idx = static_cast<size_t>(p * (values.size() - 1) + 0.5);
+        return values[idx];
+    };
+    s.p50 = pct(0.50);
+    s.p95 = pct(0.95);
+    s.p99 = pct(0.99);
+    s.max = values.back();
+    return s;
+}
+
+Telemetry::Summary Telemetry::summarize (Metric m, uint64_t firstFrame) const
+{
+    uint64_t h = frameCount();
+    size_t cnt = std::min<uint64_t>(h - std::min(h, firstFrame), capacity);
+    std::vector<uint64_t> values;
+    values.reserve(cnt);
+    for (size_t i = 0; i < cnt; ++i) {
+        auto& sample = ring[(h - cnt + i) & (capacity - 1)];
+        if (sample.missing & (1u << m)) continue;
+        values.push_back(sample.ns[m]);
+    }
+    return summarize(values);
+}
+
+void Telemetry::csvLoop ()
+{
+    std::unique_lock<std::mutex> lock(csvMutex);
+    while (!csvStop) {
+        csvCv.wait_for(lock, csvFlushInterval, [this] { return csvStop; });
+        flushCsv();
+    }
+}
+
+void Telemetry::flushCsv ()
+{
+    if (!csvFile.is_open()) return;
+// Step 1: Copy the new rows out, then drop the ones the render thread may have
+//         overwritten meanwhile (the slot of the push in progress included)
+    uint64_t h = frameCount();
+    uint64_t first = std::max(csvFlushedHead, h - std::min<uint64_t>(h, capacity));
+    csvRows.resize(h - first);
+    for (uint64_t i = first; i < h; ++i) {
+        csvRows[i - first] = ring[i & (capacity - 1)];
+    }
+    std::atomic_thread_fence(std::memory_order_acquire);
+    uint64_t h2 = frameCount();
+    uint64_t valid = h2 + 1 > capacity ? std::min(std::max(first, h2 + 1 - capacity), h) : first;
+    if (valid > csvFlushedHead) {
+        std::cerr << "[Warning] telemetry csv fell behind, " << valid - csvFlushedHead << " rows lost" << std::endl;
+    }
+// Step 2: Write them
+    for (uint64_t i = valid; i < h; ++i) {
+        auto& sample = csvRows[i - first];
+        csvFile << i;
+        for (uint32_t m = 0; m < MetricCount; ++m) {
+            csvFile << ",";
+            if (!(sample.missing & (1u << m))) {
+                csvFile << sample.ns[m];
+            }
+        }
+        csvFile << "\n";
+    }
+    csvFlushedHead = h;
+    csvFile.flush();
+}
+
+bool Telemetry::tick ()
+{
+    if (reportInterval.count() == 0) return false;
+    auto t = Clock::now();
+    if (t - lastReportTime < reportInterval) return false;
+    lastReportTime = t;
+    report();
+    return true;
+}
+
+void Telemetry::report ()
+{
+    if (frameCount() == 0) return;
+    logInfo(std::format("Telemetry over last {} frames (of {}), in ms:",
+        std::min<uint64_t>(frameCount(), capacity), frameCount()));
+    for (uint32_t m = 0; m < MetricCount; ++m) {
+        Summary s = summarize(static_cast<Metric>(m));
+        logInfo(std::format("- {:<14} p50 {:8.3f}  p95 {:8.3f}  p99 {:8.3f}  max {:8.3f}",
+            metricNames[m], s.p50 / 1e6, s.p95 / 1e6, s.p99 / 1e6, s.max / 1e6));
+    }
+    for (uint32_t i = 0; i < heapCnt; ++i) {
+        auto& h = heaps[i];
+        if (h.budget == 0) continue;
+        logInfo(std::format("- heap {:<9} {:8.1f} of {:8.1f} MiB ({:5.1f}%), peak {:8.1f} MiB",
+            i, h.usage / double(1 << 20), h.budget / double(1 << 20), 100.0 * h.usage / h.budget, h.peak / double(1 << 20)));
+    }
+}
@@ -0,0 +1,134 @@
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "Config.h"
+
+// Frame-time telemetry. The render loop pushes one FrameSample per frame into
+// a fixed-size ring; the producer only bumps an atomic head, so pushing never
+// locks, allocates or does I/O. Percentiles are computed over the ring on report().
+// With a csv, a writer thread drains the ring every csvFlushInterval, keeping file
+// I/O off the frames it measures.
+class Telemetry
+{
+public:
+    using Clock = std::chrono::steady_clock;
+
+    enum Metric : uint32_t {
+        CpuFrame = 0,      // interval between two consecutive frame starts
+        AcquireWait,       // vkAcquireNextImageKHR
+        FenceWait,         // waiting on the frame / image fences
+        Record,            // command pool reset + command buffer recording
+        SubmitPresent,     // vkQueueSubmit + vkQueuePresentKHR
+        GpuFrame,          // GPU timestamps of a previous frame, see GpuProfiler
+        MetricCount
+    };
+    static constexpr const char* metricNames[MetricCount] = {
+        "cpuFrame", "acquireWait", "fenceWait", "record", "submitPresent", "gpuFrame" };
+
+    struct FrameSample {
+        uint64_t ns[MetricCount] = {};
+    // bit m set: no value for metric m (e.g. cpuFrame of the first frame after a pause),
+    // left out of the percentiles and empty in the csv
+        uint32_t missing = 0;
+    };
+    struct Summary {
+        size_t cnt = 0;
+        uint64_t p50 = 0, p95 = 0, p99 = 0, max = 0;
+    };
+
+// Device memory per heap, latest values set by the renderer once per frame
+    struct HeapSample {
+        uint64_t usage = 0;
+        uint64_t budget = 0;
+    // highest usage seen so far
+        uint64_t peak = 0;
+    };
+    static constexpr uint32_t maxHeaps = 16;
+
+// power of two, the mask below relies on it
+    static constexpr size_t capacity = 4096;
+// rows are only lost if the renderer gets capacity frames ahead of the writer (~40k fps), see flushCsv
+    static constexpr std::chrono::milliseconds csvFlushInterval { 100 };
+
+    Telemetry () = delete;
+    Telemetry (Telemetry& rhs) = delete;
+    Telemetry (Telemetry&& rhs) = delete;
+    Telemetry (Config& cfg);
+    ~Telemetry ();
+
+    static inline Clock::time_point now ()
+    {
+        return Clock::now();
+    }
+    static inline uint64_t since (Clock::time_point t)
+    {
+        return std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - t).count();
+    }
+
+    inline void push (const FrameSample& sample)
+    {
+        uint64_t h = head.load(std::memory_order_relaxed);
+        ring[h & (capacity - 1)] = sample;
+        head.store(h + 1, std::memory_order_release);
+    }
+    inline void setHeap (uint32_t heap, uint64_t usage, uint64_t budget)
+    {
+        auto& h = heaps[heap];
+        h.usage = usage;
+        h.budget = budget;
+        h.peak = std::max(h.peak, usage);
+        heapCnt = std::max(heapCnt, heap + 1);
+    }
+    inline const HeapSample& heap (uint32_t i) const
+    {
+        return heaps[i];
+    }
+    inline uint32_t heapCount () const
+    {
+        return heapCnt;
+    }
+    inline uint64_t frameCount () const
+    {
+        return head.load(std::memory_order_acquire);
+    }
+
+// Summaries over the samples currently held in the ring, optionally only from frame firstFrame on
+    Summary summarize (Metric m, uint64_t firstFrame = 0) const;
+// Summary of arbitrary samples (sorted in place), shared with GpuProfiler
+    static Summary summarize (std::vector<uint64_t>& values);
+// Log percentiles if the report interval has elapsed, true if reported
+    bool tick ();
+    void report ();
+
+private:
+    std::array<FrameSample, capacity> ring;
+    std::atomic<uint64_t> head = 0;
+    std::array<HeapSample, maxHeaps> heaps;
+    uint32_t heapCnt = 0;
+// csv writer thread, the only user of the members below until it is joined
+    std::thread csvWriter;
+    std::mutex csvMutex;
+    std::condition_variable csvCv;
+    bool csvStop = false;
+    uint64_t csvFlushedHead = 0;
+    std::vector<FrameSample> csvRows;
+    std::ofstream csvFile;
+    std::chrono::nanoseconds reportInterval;
+    Clock::time_point lastReportTime;
+
+    void csvLoop ();
+    void flushCsv ();
+};
+
+#endif
@@ -0,0 +1,103 @@
+#ifndef UPLOADCHECK_H
+#define UPLOADCHECK_H
+
+#include <format>
+#include <exception>
+#include <vector>
+#include "utils.h"
+#include "Config.h"
+#include "Headless.h"
+#include "Uploader.h"
+
+// --check-upload: regression check of the streaming uploader; run by `make check`.
+// Throws on failure, so main exits with 1.
+
+// Step 1: StagingRing bookkeeping on its own, scripted so wraparound and a full
+// ring are hit deterministically
+inline void checkStagingRing ()
+{
+    StagingRing ring;
+    ring.init(1000, 16);
+    VkDeviceSize offset = 0;
+    auto expect = [&] (bool ok, const char* what) {
+        if (!ok) throw std::runtime_error(std::format("upload check: staging ring, {}", what));
+    };
+    expect(ring.alloc(400, offset) && offset == 0, "first allocation");
+    expect(ring.alloc(400, offset) && offset == 400, "second allocation");
+    VkDeviceSize firstEnd = 400, secondEnd = ring.end();
+    expect(!ring.alloc(400, offset), "allocation past a full ring");
+// oldest batch done: [0, 400) free again, 300 does not fit at the end and wraps
+    ring.release(firstEnd, false);
+    expect(ring.alloc(300, offset) && offset == 0 && ring.wraps() == 1, "wraparound");
+    VkDeviceSize thirdEnd = ring.end();
+    expect(!ring.alloc(200, offset), "allocation into the in-flight tail");
+    ring.release(secondEnd, false);
+    expect(ring.alloc(400, offset) && offset == 304, "aligned allocation after the wrap");
+    ring.release(thirdEnd, false);
+    ring.release(ring.end(), true);
+    expect(ring.alloc(1000, offset) && offset == 0, "whole ring once empty");
+    expect(ring.fulls() == 2, "full count");
+}
+
+// Step 2: Real uploads through a 1 MiB ring, several times its size queued at once,
+// read back and compared
+inline void runUploadCheck (Config& cfg)
+{
+    checkStagingRing();
+    constexpr size_t chunkSize = 96 << 10;
+    constexpr size_t chunkCnt = 40;
+    constexpr size_t frameLimit = 10000;
+    cfg.headless = true;
+    cfg.stagingRingMb = 1;
+    cfg.uploadBudgetKb = 4096;
+    Headless ctx(cfg);
+    Vulkan& vk = ctx.getVulkan();
+    Uploader& uploader = vk.getUploader();
+
+    VkBuffer dst;
+    GpuAllocation dstAllocation;
+    {
+        VkBufferCreateInfo bufferCreateInfo;
+        auto& ci = bufferCreateInfo;
+        ci.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+        ci.pNext = nullptr;
+        ci.flags = 0;
+        ci.size = chunkSize * chunkCnt;
+        ci.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+        ci.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        ci.queueFamilyIndexCount = 0;
+        ci.pQueueFamilyIndices = nullptr;
+        dst = vk.getAllocator().createBuffer(ci, MemoryUsage::GpuOnly, dstAllocation);
+    }
+    auto pattern = [] (size_t chunk, size_t i) {
+        return static_cast<char>((chunk * 131 + i * 7) & 0xff);
+    };
+    Uploader::Ticket last = 0;
+    for (size_t c = 0; c < chunkCnt; ++c) {
+        std::vector<char> data(chunkSize);
+        for (size_t i = 0; i < chunkSize; ++i) {
+            data[i] = pattern(c, i);
+        }
+        last = uploader.uploadBuffer(dst, c * chunkSize, std::move(data));
+    }
+    size_t frames = 0;
+    while (!uploader.complete(last)) {
+        if (++frames > frameLimit) throw std::runtime_error(std::format("upload check: not complete after {} frames", frameLimit));
+        ctx.render();
+    }
+    std::vector<char> data = vk.readBuffer(dst, chunkSize * chunkCnt);
+    vk.getAllocator().destroyBuffer(dst, dstAllocation);
+    for (size_t c = 0; c < chunkCnt; ++c) {
+        for (size_t i = 0; i < chunkSize; ++i) {
+            if (data[c * chunkSize + i] != pattern(c, i)) {
+                throw std::runtime_error(std::format("upload check: chunk {} differs at byte {}", c, i));
+            }
+        }
+    }
+    auto& ring = uploader.stagingRing();
+    if (ring.fulls() == 0) throw std::runtime_error("upload check: the ring never filled up");
+    logInfo(std::format("Upload check passed: {} KiB in {} frames, ring wrapped {} times, full {} times",
+        (chunkSize * chunkCnt) >> 10, frames, ring.wraps(), ring.fulls()));
+}
+
+#endif
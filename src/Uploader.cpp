@@ -0,0 +1,342 @@
+#include "Uploader.h"
+#include "utils.h"
+
+#include <algorithm>
+#include <cstring>
+#include <format>
+#include <limits>
+#include <stdexcept>
+
+void Uploader::init (VkDevice device, const VkPhysicalDeviceProperties& props, uint32_t transferFamily, VkQueue transferQueue,
+    uint32_t graphicsFamily, VkDeviceSize stagingSize, GpuAllocator& allocator)
+{
+    this->transferFamily = transferFamily;
+    this->graphicsFamily = graphicsFamily;
+    this->queue = transferQueue;
+    this->stagingSize = stagingSize;
+    this->allocator = &allocator;
+    copyAlignment = std::max<VkDeviceSize>(16, props.limits.optimalBufferCopyOffsetAlignment);
+    ring.init(stagingSize, copyAlignment);
+// Step 1: Command pool on the transfer family, buffers are reset one by one when recycled
+    {
+        VkCommandPoolCreateInfo commandPoolCreateInfo;
+        auto& ci = commandPoolCreateInfo;
+        ci.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+        ci.pNext = nullptr;
+        ci.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT | VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT;
+        ci.queueFamilyIndex = transferFamily;
+        VkResult r = vkCreateCommandPool(device, &ci, nullptr, &commandPool);
+        if (r != VK_SUCCESS) throw std::runtime_error(std::format("vkCreateCommandPool: {}", (int)r));
+    }
+// Step 2: Timeline semaphore, value n = batch n completed
+    {
+        VkSemaphoreTypeCreateInfo semaphoreTypeCreateInfo;
+        semaphoreTypeCreateInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO;
+        semaphoreTypeCreateInfo.pNext = nullptr;
+        semaphoreTypeCreateInfo.semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE;
+        semaphoreTypeCreateInfo.initialValue = 0;
+        VkSemaphoreCreateInfo semaphoreCreateInfo;
+        auto& ci = semaphoreCreateInfo;
+        ci.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+        ci.pNext = &semaphoreTypeCreateInfo;
+        ci.flags = 0;
+        VkResult r = vkCreateSemaphore(device, &ci, nullptr, &timelineSemaphore);
+        if (r != VK_SUCCESS) throw std::runtime_error(std::format("vkCreateSemaphore: {}", (int)r));
+    }
+// Step 3: Staging ring, host-visible and mapped for the lifetime of the uploader
+    {
+        VkBufferCreateInfo bufferCreateInfo;
+        auto& ci = bufferCreateInfo;
+        ci.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+        ci.pNext = nullptr;
+        ci.flags = 0;
+        ci.size = stagingSize;
+        ci.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+        ci.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        ci.queueFamilyIndexCount = 0;
+        ci.pQueueFamilyIndices = nullptr;
+        // coherent: no flushes needed, the submission makes host writes visible
+        stagingBuffer = allocator.createBuffer(ci, MemoryUsage::Upload, stagingAllocation);
+        stagingMapped = static_cast<char*>(stagingAllocation.mapped);
+    }
+// at most one batch per frame is submitted, a few in flight is plenty; more are added on demand
+    batches.reserve(8);
+    logInfo(std::format("Uploader: transfer family {}, {} MiB staging ring", transferFamily, stagingSize >> 20));
+}
+
+void Uploader::destroy (VkDevice device)
+{
+    if (commandPool == VK_NULL_HANDLE) return;
+    // frees the batches' command buffers too
+    vkDestroyCommandPool(device, commandPool, nullptr);
+    vkDestroySemaphore(device, timelineSemaphore, nullptr);
+    allocator->destroyBuffer(stagingBuffer, stagingAllocation);
+    commandPool = VK_NULL_HANDLE;
+    batches.clear();
+    inFlight.clear();
+}
+
+Uploader::Ticket Uploader::enqueue (Request&& req)
+{
+// a zero-sized copy is invalid usage, and the ring would still advance for it
+    if (req.data.empty()) {
+        throw std::runtime_error("upload of 0 bytes");
+    }
+    if (req.data.size() + copyAlignment > stagingSize) {
+        throw std::runtime_error(std::format("upload of {} bytes exceeds the staging ring ({} bytes)", req.data.size(), stagingSize));
+    }
+    std::lock_guard<std::mutex> lock(pendingMutex);
+    req.ticket = nextTicket++;
+    queuedBytes.fetch_add(req.data.size(), std::memory_order_relaxed);
+    pending.push_back(std::move(req));
+    return pending.back().ticket;
+}
+
+Uploader::Ticket Uploader::uploadBuffer (VkBuffer dst, VkDeviceSize dstOffset, std::vector<char> data)
+{
+    Request req;
+    req.buffer = dst;
+    req.dstOffset = dstOffset;
+    req.data = std::move(data);
+    return enqueue(std::move(req));
+}
+
+Uploader::Ticket Uploader::uploadImage (VkImage dst, VkExtent3D extent, uint32_t mipLevel, VkImageLayout finalLayout, std::vector<char> data)
+{
+    Request req;
+    req.image = dst;
+    req.extent = extent;
+    req.mipLevel = mipLevel;
+    req.finalLayout = finalLayout;
+    req.data = std::move(data);
+    return enqueue(std::move(req));
+}
+
+void Uploader::retire (VkDevice device)
+{
+    uint64_t completed = 0;
+    vkGetSemaphoreCounterValue(device, timelineSemaphore, &completed);
+    while (!inFlight.empty() && inFlight.front()->value <= completed) {
+        Batch& batch = *inFlight.front();
+        inFlight.pop_front();
+        ring.release(batch.ringEnd, inFlight.empty());
+        readyBufferAcquires.insert(readyBufferAcquires.end(), batch.bufferAcquires.begin(), batch.bufferAcquires.end());
+        readyImageAcquires.insert(readyImageAcquires.end(), batch.imageAcquires.begin(), batch.imageAcquires.end());
+        readyTicket = std::max(readyTicket, batch.lastTicket);
+        readyValue = std::max(readyValue, batch.value);
+        batch.value = 0;
+    }
+}
+
+Uploader::Batch& Uploader::freeBatch (VkDevice device)
+{
+    for (auto& el : batches) {
+        if (el.value == 0 && el.commandBuffer != VK_NULL_HANDLE) {
+            vkResetCommandBuffer(el.commandBuffer, 0);
+            return el;
+        }
+    }
+    // all in flight: add one (pointers in inFlight must stay valid, grow only within capacity)
+    if (batches.size() == batches.capacity()) {
+        throw std::runtime_error("uploader: too many batches in flight");
+    }
+    Batch& batch = batches.emplace_back();
+    VkCommandBufferAllocateInfo commandBufferAllocateInfo;
+    auto& ai = commandBufferAllocateInfo;
+    ai.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    ai.pNext = nullptr;
+    ai.commandPool = commandPool;
+    ai.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+    ai.commandBufferCount = 1;
+    VkResult r = vkAllocateCommandBuffers(device, &ai, &(batch.commandBuffer));
+    if (r != VK_SUCCESS) throw std::runtime_error(std::format("vkAllocateCommandBuffers: {}", (int)r));
+    return batch;
+}
+
+void Uploader::pump (VkDevice device, VkDeviceSize budget)
+{
+    retire(device);
+// Step 1: Take requests in order while they fit the budget and the ring;
+// the first one may exceed the budget alone so big uploads cannot starve
+    auto& reqs = stagedRequests;
+    reqs.clear();
+    VkDeviceSize staged = 0;
+    {
+        std::lock_guard<std::mutex> lock(pendingMutex);
+        while (!pending.empty()) {
+            auto& front = pending.front();
+            if (staged > 0 && staged + front.data.size() > budget) break;
+            if (batches.size() == batches.capacity() && inFlight.size() == batches.size()) break;
+            VkDeviceSize offset;
+            if (!ring.alloc(front.data.size(), offset)) break;
+            front.stagingOffset = offset;
+            staged += front.data.size();
+            reqs.push_back(std::move(front));
+            pending.pop_front();
+        }
+    }
+    if (reqs.empty()) return;
+    queuedBytes.fetch_sub(staged, std::memory_order_relaxed);
+// Step 2: Copy into the ring, record and submit one batch
+    for (auto& req : reqs) {
+        std::memcpy(stagingMapped + req.stagingOffset, req.data.data(), req.data.size());
+    }
+    Batch& batch = freeBatch(device);
+    record(batch, reqs);
+    batch.value = nextValue++;
+    batch.ringEnd = ring.end();
+    batch.lastTicket = reqs.back().ticket;
+    // frees the requests' data now, the vector keeps its capacity for the next pump
+    reqs.clear();
+    VkTimelineSemaphoreSubmitInfo timelineSubmitInfo;
+    {
+        auto& si = timelineSubmitInfo;
+        si.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+        si.pNext = nullptr;
+        si.waitSemaphoreValueCount = 0;
+        si.pWaitSemaphoreValues = nullptr;
+        si.signalSemaphoreValueCount = 1;
+        si.pSignalSemaphoreValues = &(batch.value);
+    }
+    VkSubmitInfo submitInfo;
+    {
+        auto& si = submitInfo;
+        si.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        si.pNext = &timelineSubmitInfo;
+        si.waitSemaphoreCount = 0;
+        si.pWaitSemaphores = nullptr;
+        si.pWaitDstStageMask = nullptr;
+        si.commandBufferCount = 1;
+        si.pCommandBuffers = &(batch.commandBuffer);
+        si.signalSemaphoreCount = 1;
+        si.pSignalSemaphores = &timelineSemaphore;
+    }
+    VkResult r = vkQueueSubmit(queue, 1, &submitInfo, VK_NULL_HANDLE);
+    if (r != VK_SUCCESS) throw std::runtime_error(std::format("vkQueueSubmit: {}", (int)r));
+    inFlight.push_back(&batch);
+}
+
+void Uploader::record (Batch& batch, std::vector<Request>& reqs)
+{
+    bool transferOwnership = transferFamily != graphicsFamily;
+    batch.bufferAcquires.clear();
+    batch.imageAcquires.clear();
+    toTransferDst.clear();
+    toFinal.clear();
+    bufferReleases.clear();
+    for (auto& req : reqs) {
+        if (req.image != VK_NULL_HANDLE) {
+            VkImageMemoryBarrier barrier;
+            barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+            barrier.pNext = nullptr;
+            barrier.srcAccessMask = 0;
+            barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+            // previous contents are overwritten entirely
+            barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+            barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+            barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+            barrier.image = req.image;
+            barrier.subresourceRange = VkImageSubresourceRange {
+                .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+                .baseMipLevel = req.mipLevel,
+                .levelCount = 1,
+                .baseArrayLayer = 0,
+                .layerCount = 1
+            };
+            toTransferDst.push_back(barrier);
+            // release (or plain transition on one family); the acquire repeats the layout transition
+            barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+            barrier.dstAccessMask = 0;
+            barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+            barrier.newLayout = req.finalLayout;
+            if (transferOwnership) {
+                barrier.srcQueueFamilyIndex = transferFamily;
+                barrier.dstQueueFamilyIndex = graphicsFamily;
+            }
+            toFinal.push_back(barrier);
+            if (transferOwnership) {
+                barrier.srcAccessMask = 0;
+                barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+                batch.imageAcquires.push_back(barrier);
+            }
+        } else if (transferOwnership) {
+            VkBufferMemoryBarrier barrier;
+            barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+            barrier.pNext = nullptr;
+            barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+            barrier.dstAccessMask = 0;
+            barrier.srcQueueFamilyIndex = transferFamily;
+            barrier.dstQueueFamilyIndex = graphicsFamily;
+            barrier.buffer = req.buffer;
+            barrier.offset = req.dstOffset;
+            barrier.size = req.data.size();
+            bufferReleases.push_back(barrier);
+            barrier.srcAccessMask = 0;
+            barrier.dstAccessMask = VK_ACCESS_MEMORY_READ_BIT;
+            batch.bufferAcquires.push_back(barrier);
+        }
+    }
+
+    VkCommandBufferBeginInfo commandBufferBeginInfo;
+    {
+        auto& ci = commandBufferBeginInfo;
+        ci.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        ci.pNext = nullptr;
+        ci.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+        ci.pInheritanceInfo = nullptr;
+    }
+    VkCommandBuffer cb = batch.commandBuffer;
+    vkBeginCommandBuffer(cb, &commandBufferBeginInfo);
+// all layout transitions first, then all copies, then all releases: three barriers per batch at most
+    if (!toTransferDst.empty()) {
+        vkCmdPipelineBarrier(cb, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT,
+            0, 0, nullptr, 0, nullptr, toTransferDst.size(), toTransferDst.data());
+    }
+    for (auto& req : reqs) {
+        if (req.image != VK_NULL_HANDLE) {
+            VkBufferImageCopy region;
+            region.bufferOffset = req.stagingOffset;
+            region.bufferRowLength = 0;
+            region.bufferImageHeight = 0;
+            region.imageSubresource = VkImageSubresourceLayers {
+                .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT,
+                .mipLevel = req.mipLevel,
+                .baseArrayLayer = 0,
+                .layerCount = 1
+            };
+            region.imageOffset = VkOffset3D { 0, 0, 0 };
+            // full mip level: always valid, whatever the queue's image transfer granularity
+            region.imageExtent = req.extent;
+            vkCmdCopyBufferToImage(cb, stagingBuffer, req.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+        } else {
+            VkBufferCopy region;
+            region.srcOffset = req.stagingOffset;
+            region.dstOffset = req.dstOffset;
+            region.size = req.data.size();
+            vkCmdCopyBuffer(cb, stagingBuffer, req.buffer, 1, &region);
+        }
+    }
+    // visibility for graphics comes from its wait on the timeline semaphore
+    if (!toFinal.empty() || !bufferReleases.empty()) {
+        vkCmdPipelineBarrier(cb, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT,
+            0, 0, nullptr, bufferReleases.size(), bufferReleases.data(), toFinal.size(), toFinal.data());
+    }
+    VkResult r = vkEndCommandBuffer(cb);
+    if (r != VK_SUCCESS) throw std::runtime_error(std::format("vkEndCommandBuffer: {}", (int)r));
+}
+
+uint64_t Uploader::recordAcquires (VkCommandBuffer cb)
+{
+    if (readyValue == 0) return 0;
+    if (!readyBufferAcquires.empty() || !readyImageAcquires.empty()) {
+        vkCmdPipelineBarrier(cb, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_ALL_COMMANDS_BIT,
+            0, 0, nullptr, readyBufferAcquires.size(), readyBufferAcquires.data(), readyImageAcquires.size(), readyImageAcquires.data());
+        readyBufferAcquires.clear();
+        readyImageAcquires.clear();
+    }
+    completedTicket.store(readyTicket, std::memory_order_release);
+    uint64_t value = readyValue;
+    readyValue = 0;
+    return value;
+}
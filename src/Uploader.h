@@ -0,0 +1,214 @@
+#ifndef UPLOADER_H
+#define UPLOADER_H
+
+#include <vulkan/vulkan.h>
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <vector>
+#include "GpuAllocator.h"
+
+// Bookkeeping of the staging ring, no Vulkan: [tail, head) is in flight (wrapping),
+// the rest is free. Allocations never straddle the end, one that does not fit
+// before it wraps to 0. Batches are released in submission order.
+class StagingRing
+{
+public:
+    inline void init (VkDeviceSize size, VkDeviceSize alignment)
+    {
+        this->size = size;
+        this->alignment = alignment;
+        head = tail = 0;
+        empty = true;
+    }
+// false if the ring is full, nothing changes then
+    inline bool alloc (VkDeviceSize bytes, VkDeviceSize& offset)
+    {
+        VkDeviceSize aligned = (head + alignment - 1) / alignment * alignment;
+        if (empty || head > tail) {
+            // free: [head, end) and [0, tail)
+            if (aligned + bytes <= size) {
+                offset = aligned;
+            } else if (bytes <= tail) {
+                offset = 0;
+                ++wrapCnt;
+            } else {
+                ++fullCnt;
+                return false;
+            }
+        } else {
+            // free: [head, tail)
+            if (aligned + bytes > tail) {
+                ++fullCnt;
+                return false;
+            }
+            offset = aligned;
+        }
+        head = offset + bytes;
+        empty = false;
+        return true;
+    }
+// position after the last allocation, what a batch passes to release() once complete
+    inline VkDeviceSize end () const
+    {
+        return head;
+    }
+// the oldest batch completed; lastInFlight: it was the only one left
+    inline void release (VkDeviceSize batchEnd, bool lastInFlight)
+    {
+        tail = batchEnd;
+        empty = lastInFlight;
+        if (empty) {
+            head = tail = 0;
+        }
+    }
+    inline VkDeviceSize capacity () const
+    {
+        return size;
+    }
+// times an allocation wrapped to the start / was refused, for checks and tuning
+    inline uint64_t wraps () const
+    {
+        return wrapCnt;
+    }
+    inline uint64_t fulls () const
+    {
+        return fullCnt;
+    }
+
+private:
+    VkDeviceSize size = 0;
+    VkDeviceSize alignment = 16;
+    VkDeviceSize head = 0;
+    VkDeviceSize tail = 0;
+    bool empty = true;
+    uint64_t wrapCnt = 0;
+    uint64_t fullCnt = 0;
+};
+
+// Streaming uploads through the transfer queue.
+//
+// Any thread queues buffer / image uploads (the data is moved in); the render
+// thread calls pump() once per frame, which copies as many queued requests as the
+// per-frame budget allows into a persistently mapped staging ring and records
+// their vkCmdCopyBuffer / vkCmdCopyBufferToImage into one batch submitted to the
+// transfer queue. Each batch signals the next value of a timeline semaphore; the
+// ring space and command buffer of a batch are recycled once the semaphore
+// reached its value, so nothing on the CPU ever blocks on an upload.
+//
+// Transfer and graphics of different families: destinations are released by the
+// batch and acquired by recordAcquires() in the graphics primary. The graphics
+// submission then waits on the timeline value returned by recordAcquires(), which
+// has already been reached when it is recorded, so the wait never stalls.
+// A request is complete (ready for graphics) once its acquire has been recorded.
+class Uploader
+{
+public:
+    using Ticket = uint64_t;
+
+    Uploader () = default;
+    Uploader (Uploader& rhs) = delete;
+    Uploader (Uploader&& rhs) = delete;
+
+    void init (VkDevice device, const VkPhysicalDeviceProperties& props, uint32_t transferFamily, VkQueue transferQueue,
+        uint32_t graphicsFamily, VkDeviceSize stagingSize, GpuAllocator& allocator);
+    void destroy (VkDevice device);
+
+// Any thread. The whole of data (not empty) is copied to dst at dstOffset.
+    Ticket uploadBuffer (VkBuffer dst, VkDeviceSize dstOffset, std::vector<char> data);
+// Any thread. Fills one full mip level of a color image, rows tightly packed;
+// the image is left in finalLayout (and owned by the graphics family).
+    Ticket uploadImage (VkImage dst, VkExtent3D extent, uint32_t mipLevel, VkImageLayout finalLayout, std::vector<char> data);
+// Any thread, true once the upload is visible to graphics work recorded after it
+    inline bool complete (Ticket ticket) const
+    {
+        return ticket <= completedTicket.load(std::memory_order_acquire);
+    }
+
+// Render thread, once per frame: recycle finished batches, stage and submit up to budget bytes
+    void pump (VkDevice device, VkDeviceSize budget);
+// Render thread, graphics primary outside a render pass: acquire what finished batches
+// released. Returns the timeline value the graphics submission has to wait for, 0 for none.
+    uint64_t recordAcquires (VkCommandBuffer cb);
+    inline VkSemaphore timeline () const
+    {
+        return timelineSemaphore;
+    }
+// bytes queued but not yet staged
+    inline uint64_t pendingBytes () const
+    {
+        return queuedBytes.load(std::memory_order_relaxed);
+    }
+// Render thread
+    inline const StagingRing& stagingRing () const
+    {
+        return ring;
+    }
+
+private:
+    struct Request {
+        Ticket ticket = 0;
+        VkBuffer buffer = VK_NULL_HANDLE;
+        VkDeviceSize dstOffset = 0;
+        VkImage image = VK_NULL_HANDLE;
+        VkExtent3D extent = {0, 0, 0};
+        uint32_t mipLevel = 0;
+        VkImageLayout finalLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+        std::vector<char> data;
+        VkDeviceSize stagingOffset = 0;
+    };
+    struct Batch {
+        VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+    // timeline value signaled when the batch completes, 0 while the batch is free
+        uint64_t value = 0;
+    // ring head after this batch, the ring tail moves here once it completes
+        VkDeviceSize ringEnd = 0;
+        Ticket lastTicket = 0;
+        std::vector<VkBufferMemoryBarrier> bufferAcquires;
+        std::vector<VkImageMemoryBarrier> imageAcquires;
+    };
+
+    uint32_t transferFamily = 0;
+    uint32_t graphicsFamily = 0;
+    VkQueue queue = VK_NULL_HANDLE;
+    VkCommandPool commandPool = VK_NULL_HANDLE;
+    VkSemaphore timelineSemaphore = VK_NULL_HANDLE;
+    uint64_t nextValue = 1;
+    std::vector<Batch> batches;
+
+// Staging buffer, allocated through ring
+    VkBuffer stagingBuffer = VK_NULL_HANDLE;
+    GpuAllocation stagingAllocation;
+    GpuAllocator* allocator = nullptr;
+    char* stagingMapped = nullptr;
+    VkDeviceSize stagingSize = 0;
+    VkDeviceSize copyAlignment = 16;
+    StagingRing ring;
+// batches in flight, oldest first
+    std::deque<Batch*> inFlight;
+
+    std::mutex pendingMutex;
+    std::deque<Request> pending;
+    Ticket nextTicket = 1;
+    std::atomic<uint64_t> queuedBytes = 0;
+
+// acquires of completed batches, recorded into the next graphics primary
+    std::vector<VkBufferMemoryBarrier> readyBufferAcquires;
+    std::vector<VkImageMemoryBarrier> readyImageAcquires;
+    Ticket readyTicket = 0;
+    uint64_t readyValue = 0;
+    std::atomic<Ticket> completedTicket = 0;
+
+// pump() / record() temporaries, kept as members so a steady stream of uploads does not allocate
+    std::vector<Request> stagedRequests;
+    std::vector<VkImageMemoryBarrier> toTransferDst, toFinal;
+    std::vector<VkBufferMemoryBarrier> bufferReleases;
+
+    Ticket enqueue (Request&& req);
+    void retire (VkDevice device);
+    Batch& freeBatch (VkDevice device);
+    void record (Batch& batch, std::vector<Request>& reqs);
+};
+
+#endif
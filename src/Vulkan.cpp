@@ -9,231 +9,768 @@
 #include <algorithm>
 #include <limits>
 #include <chrono>
+#include <cmath>
+#include <thread>
 
 void Vulkan::buildSwapchain ()
 {
     createSwapchain();
+    getSwapchainImages();
     createSwapchainImageView();
     createFramebuffer();
 }
 
+void Vulkan::buildOffscreenTargets ()
+{
+    createOffscreenImages();
+    createSwapchainImageView();
+    createFramebuffer();
+    logInfo(std::format("Headless: {} offscreen images ( {} x {} )", swapchainImages.size(), swapchainExtent.width, swapchainExtent.height));
+}
+
 void Vulkan::buildGraphicsPipeline ()
 {
     createRenderPass();
     createShaderModule();
     createGraphicsPipeline();
+// returns at once, the rest of init overlaps with compilation and render() waits
+// only for the pipelines its frame uses
+    pipelines.compile();
+    pipeline = VK_NULL_HANDLE;
+    ++pipelineGeneration;
+}
+
+void Vulkan::destroySwapchainResources ()
+{
+    for (auto& el : framebuffers) {
+        vkDestroyFramebuffer(device, el, nullptr);
+    }
+    framebuffers.clear();
+    for (auto& el : swapchainImageViews) {
+        vkDestroyImageView(device, el, nullptr);
+    }
+    swapchainImageViews.clear();
+}
+
+void Vulkan::destroyOffscreenImages ()
+{
+    for (uint32_t i = 0; i < swapchainImages.size(); ++i) {
+        allocator.destroyImage(swapchainImages[i], offscreenImageAllocations[i]);
+    }
+    swapchainImages.clear();
+    offscreenImageAllocations.clear();
+}
+
+void Vulkan::rebuildSwapchain ()
+{
+// Skip while minimized (zero-sized surface), stay dirty until the window comes back
+    VkExtent2D extent = cfg.headless ? windowExtent : querySwapchainExtent();
+    if (extent.width == 0 || extent.height == 0) {
+        return;
+    }
+// Only framebuffers and image views depend on the swapchain images,
+// pipeline and frame contexts (command pools included) are kept; command buffers
+// are recorded per frame and pick up the new framebuffers by themselves
+    vkDeviceWaitIdle(device);
+    destroySwapchainResources();
+    if (cfg.headless) {
+        destroyOffscreenImages();
+        buildOffscreenTargets();
+        nextOffscreenImage = 0;
+    } else {
+        buildSwapchain();
+    }
+    buildImageSyncs();
+    swapchainDirty = false;
+    logInfo(std::format("Swapchain rebuilt ( {} x {} ), {} images", swapchainExtent.width, swapchainExtent.height, swapchainImages.size()));
 }
 
 void Vulkan::buildCommandBuffer ()
 {
-// Step 1: Create command pools (1 command pool per queue family)
-    std::vector<VkCommandPoolCreateInfo> commandPoolCreateInfos;
-    commandPoolCreateInfos.resize(queueFamilyInUse.size());
-    commandPools.resize(queueFamilyInUse.size());
-    for (uint32_t i = 0; i < commandPoolCreateInfos.size(); ++i) {
-        auto& ci = commandPoolCreateInfos[i];
-        ci.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+// Step 1: Create frame contexts (transient command pool + command buffer each), see FrameContext.h
+    frames.resize(cfg.framesInFlight);
+    for (auto& frame : frames) {
+        frame.init(device, graphicsQueue.family);
+    }
+// Step 2: Create per-frame pools for secondary command buffers, one set per job system thread
+    secondaryRecorder.init(device, graphicsQueue.family, jobSystem.threadCount(), frames.size());
+    if (cfg.recordMode == "cached") {
+        bucketCache.init(device, graphicsQueue.family, frames.size());
+    }
+// culling pass on the compute queue, graphics then draws indirect
+    if (cfg.asyncCompute) {
+        ScratchArena::Scope scope(scratch);
+        ScratchVector<char> cullSpirv = readShaderCode("cull.comp");
+        asyncCompute.init(device, computeQueue.family, graphicsQueue.family, frames.size(),
+            std::span<const char>(cullSpirv.data(), cullSpirv.size()), allocator, pipelineCache.get());
+    }
+// streaming uploads through the transfer queue
+    uploader.init(device, physicalDeviceProperties, transferQueue.family, transferQueue.queue, graphicsQueue.family,
+        VkDeviceSize(cfg.stagingRingMb) << 20, allocator);
+    createVertexBuffer();
+// one profiler slot per frame in flight
+    gpuProfiler.init(device, physicalDeviceProperties, queueFamilyProperties[graphicsQueue.family], frames.size());
+// Step 3: Create per-image syncs
+    buildImageSyncs();
+    logInfo(std::format("Frames in flight: {}, swapchain images: {}, present mode: {} (requested {})",
+        frames.size(), swapchainImages.size(), (int)selectedPresentMode, cfg.presentMode));
+}
+
+// hue in [0, 1) at full saturation / value
+static void hueToRgb (float hue, float rgb[3])
+{
+    float h = hue * 6.0f;
+    float x = 1.0f - std::abs(std::fmod(h, 2.0f) - 1.0f);
+    int sector = static_cast<int>(h) % 6;
+    const float table[6][3] = {
+        {1.0f, x, 0.0f}, {x, 1.0f, 0.0f}, {0.0f, 1.0f, x},
+        {0.0f, x, 1.0f}, {x, 0.0f, 1.0f}, {1.0f, 0.0f, x}
+    };
+    for (size_t i = 0; i < 3; ++i) {
+        rgb[i] = table[sector][i];
+    }
+}
+
+void Vulkan::recordDraws (VkCommandBuffer cb, size_t first, size_t cnt)
+{
+// bind pipeline to command buffer of the graphics queue
+    vkCmdBindPipeline(cb, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+    VkDeviceSize vertexOffset = 0;
+    vkCmdBindVertexBuffers(cb, 0, 1, &vertexBuffer, &vertexOffset);
+// dynamic state is not inherited by secondaries, every command buffer sets its own
+    VkViewport viewport = { 0.0f, 0.0f, float(swapchainExtent.width), float(swapchainExtent.height), 0.0f, 1.0f };
+    VkRect2D scissor = { VkOffset2D { 0, 0 }, swapchainExtent };
+    vkCmdSetViewport(cb, 0, 1, &viewport);
+    vkCmdSetScissor(cb, 0, 1, &scissor);
+// frame uniforms always come first in the frame's arena slice, so the offset is fixed
+// per frame index and cached secondaries of that frame stay valid; the bindless set is
+// bound along and stays bound, draws only push their handles
+    std::array<VkDescriptorSet, 2> sets = { frameArena.set(), bindless.set() };
+    vkCmdBindDescriptorSets(cb, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, bindless.enabled() ? 2 : 1, sets.data(), 1, &frameUniformOffset);
+    vkCmdPushConstants(cb, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(drawHandles), &drawHandles);
+// async compute: the same range of the frame's culled indirect commands,
+// in batches of maxDrawIndirectCount (1 without multiDrawIndirect)
+    if (cfg.asyncCompute) {
+        VkBuffer indirect = asyncCompute.indirectBuffer(frameIdx);
+        uint32_t maxBatch = std::max(1u, physicalDeviceProperties.limits.maxDrawIndirectCount);
+        while (cnt > 0) {
+            uint32_t batch = std::min<size_t>(cnt, maxBatch);
+            vkCmdDrawIndirect(cb, indirect, first * sizeof(DrawCmd), batch, sizeof(DrawCmd));
+            first += batch;
+            cnt -= batch;
+        }
+        return;
+    }
+    for (size_t i = first; i < first + cnt; ++i) {
+        auto& d = drawList[i];
+        vkCmdDraw(cb, d.vertexCnt, d.instanceCnt, d.firstVertex, d.firstInstance);
+    }
+}
+
+void Vulkan::recordSecondaryCommandBuffers (uint32_t imageIdx)
+{
+// Split drawList into chunks of at least recordChunkSize draws, a few chunks per thread
+// so idle workers have something to steal; secondaryCommandBuffers[i] holds chunk i, executed in order
+    uint32_t threadCnt = jobSystem.threadCount();
+    size_t chunkCnt = std::min<size_t>(drawList.size() / cfg.recordChunkSize, threadCnt * 4);
+    size_t chunkSize = (drawList.size() + chunkCnt - 1) / chunkCnt;
+    secondaryCommandBuffers.resize(chunkCnt);
+
+    VkCommandBufferInheritanceInfo inheritanceInfo;
+    {
+        auto& ii = inheritanceInfo;
+        ii.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+        ii.pNext = nullptr;
+        ii.renderPass = renderPass;
+        ii.subpass = 0;
+        ii.framebuffer = framebuffers[imageIdx];
+        ii.occlusionQueryEnable = VK_FALSE;
+        ii.queryFlags = 0;
+        ii.pipelineStatistics = 0;
+    }
+    VkCommandBufferBeginInfo commandBufferBeginInfo;
+    {
+        auto& ci = commandBufferBeginInfo;
+        ci.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
         ci.pNext = nullptr;
-        ci.flags = 0;
-        ci.queueFamilyIndex = queueFamilyInUse[i];
-        VkResult r = vkCreateCommandPool(device, &ci, nullptr, &(commandPools[i]));
-        if (r != VK_SUCCESS) throw std::runtime_error(std::format("vkCreateCommandPool: {}", (int)r));
+    // executed entirely inside the render pass begun by the primary
+        ci.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT | VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+        ci.pInheritanceInfo = &inheritanceInfo;
     }
-// Step 2: Allocate command buffer (1 command buffer per queue family per framebuffer)
-    std::vector<VkCommandBufferAllocateInfo> commandBufferAllocateInfos;
-    commandBufferAllocateInfos.resize(commandPools.size());
-    commandBuffers.resize(commandPools.size());
-    for (uint32_t i = 0; i < commandBufferAllocateInfos.size(); ++i) {
-        auto& ci = commandBufferAllocateInfos[i];
-        auto& cbs = commandBuffers[i];
-        ci.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+    jobSystem.parallelFor(0, chunkCnt, 1, [&] (size_t chunk, size_t) {
+        size_t first = chunk * chunkSize;
+        size_t cnt = std::min(chunkSize, drawList.size() - first);
+    // pools are per thread, the job may run on any of them
+        VkCommandBuffer cb = secondaryRecorder.acquire(device, jobSystem.threadIndex(), frameIdx);
+        vkBeginCommandBuffer(cb, &commandBufferBeginInfo);
+        recordDraws(cb, first, cnt);
+        VkResult r = vkEndCommandBuffer(cb);
+        if (r != VK_SUCCESS) throw std::runtime_error(std::format("vkEndCommandBuffer: {}", (int)r));
+        secondaryCommandBuffers[chunk] = cb;
+    });
+}
+
+void Vulkan::recordBuckets ()
+{
+// Key of a bucket's cached secondary: its draws and the state recorded against them.
+// Bucket hashes are kept up to date by setBucketDraws, so this is O(buckets) per frame.
+// The extent is part of it because the viewport / scissor are recorded into the buffers;
+// with async compute so is the bucket's first draw, baked in as the indirect buffer offset.
+    uint64_t extentKey = uint64_t(swapchainExtent.width) << 32 | swapchainExtent.height;
+    uint64_t stateKey = pipelineGeneration * 0x9e3779b97f4a7c15ull ^ asyncCompute.generation() ^ extentKey * 0xff51afd7ed558ccdull;
+    std::array<std::pair<RenderBucket, VkCommandBuffer>, BucketCount> stale;
+    size_t staleCnt = 0;
+    secondaryCommandBuffers.clear();
+    for (uint32_t i = 0; i < BucketCount; ++i) {
+        auto bucket = static_cast<RenderBucket>(i);
+        if (buckets[i].cnt == 0) continue;
+        uint64_t key = buckets[i].hash ^ stateKey;
+        if (cfg.asyncCompute) {
+            key ^= (buckets[i].first + 1) * 0xc4ceb9fe1a85ec53ull;
+        }
+        VkCommandBuffer cb = bucketCache.stale(device, bucket, frameIdx, key);
+        if (cb != VK_NULL_HANDLE) {
+            stale[staleCnt++] = { bucket, cb };
+        }
+        secondaryCommandBuffers.push_back(bucketCache.get(bucket, frameIdx));
+    }
+    if (staleCnt == 0) return;
+
+// No framebuffer in the inheritance info: the cached buffers stay valid for any swapchain image
+    VkCommandBufferInheritanceInfo inheritanceInfo;
+    {
+        auto& ii = inheritanceInfo;
+        ii.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO;
+        ii.pNext = nullptr;
+        ii.renderPass = renderPass;
+        ii.subpass = 0;
+        ii.framebuffer = VK_NULL_HANDLE;
+        ii.occlusionQueryEnable = VK_FALSE;
+        ii.queryFlags = 0;
+        ii.pipelineStatistics = 0;
+    }
+    VkCommandBufferBeginInfo commandBufferBeginInfo;
+    {
+        auto& ci = commandBufferBeginInfo;
+        ci.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
         ci.pNext = nullptr;
-        ci.commandPool = commandPools[i];
-        ci.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-        ci.commandBufferCount = framebuffers.size();
-        cbs.resize(framebuffers.size());
-        VkResult r = vkAllocateCommandBuffers(device, &ci, cbs.data());
-        if (r != VK_SUCCESS) throw std::runtime_error(std::format("vkAllocateCommandBuffers: {}", (int)r));
+    // reused across frames, so no ONE_TIME_SUBMIT
+        ci.flags = VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT;
+        ci.pInheritanceInfo = &inheritanceInfo;
+    }
+// stale buckets record in parallel, each into its own pool
+    jobSystem.parallelFor(0, staleCnt, 1, [&] (size_t i, size_t) {
+        auto [bucket, cb] = stale[i];
+        vkBeginCommandBuffer(cb, &commandBufferBeginInfo);
+        recordDraws(cb, buckets[bucket].first, buckets[bucket].cnt);
+        VkResult r = vkEndCommandBuffer(cb);
+        if (r != VK_SUCCESS) throw std::runtime_error(std::format("vkEndCommandBuffer: {}", (int)r));
+    });
+}
+
+void Vulkan::setBucketDraws (RenderBucket bucket, const std::vector<DrawCmd>& draws)
+{
+    auto& range = buckets[bucket];
+    uint64_t hash = hashDraws(draws.data(), draws.size());
+    if (hash == range.hash && draws.size() == range.cnt) return;
+// splice the new draws in and shift the following buckets
+    auto first = drawList.begin() + range.first;
+    drawList.erase(first, first + range.cnt);
+    drawList.insert(drawList.begin() + range.first, draws.begin(), draws.end());
+    range.cnt = draws.size();
+    range.hash = hash;
+    ++drawListVersion;
+    for (uint32_t i = bucket + 1; i < BucketCount; ++i) {
+        buckets[i].first = buckets[i - 1].first + buckets[i - 1].cnt;
     }
-// Step 3: Record commands
+}
+
+void Vulkan::recordCommandBuffer (VkCommandBuffer cb, uint32_t imageIdx)
+{
     VkCommandBufferBeginInfo commandBufferBeginInfo;
     {
         auto& ci = commandBufferBeginInfo;
         ci.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
         ci.pNext = nullptr;
-        ci.flags = VK_COMMAND_BUFFER_USAGE_SIMULTANEOUS_USE_BIT;
+        ci.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
         ci.pInheritanceInfo = nullptr;
     }
-    {
-    // use queue family 0 for graphics pipeline
-        auto& cbs = commandBuffers[0];
-        // i is index for framebuffer
-        for (uint32_t i = 0; i < cbs.size(); ++i) {
-        // Command buffer: Initial -> Recording
-            vkBeginCommandBuffer(cbs[i], &commandBufferBeginInfo);
-        // begin render pass
-            std::vector<VkRenderPassBeginInfo> renderPassBeginInfos;
-            std::vector<VkClearValue> attachmentClearValues;
-            {
-                attachmentClearValues.resize(attachments.size());
-                for (auto& el : attachmentClearValues) {
-                    for (size_t i = 0; i < 4; ++i) {
-                        el.color.float32[i] = 0.0f;
-                    }
-                }
-                renderPassBeginInfos.resize(framebuffers.size());
-                for (uint32_t i = 0; i < framebuffers.size(); ++i) {
-                    auto& ci = renderPassBeginInfos[i];
-                    ci.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
-                    ci.pNext = nullptr;
-                    ci.renderPass = renderPass;
-                    ci.framebuffer = framebuffers[i];
-                    ci.renderArea = VkRect2D {
-                        .offset = VkOffset2D {
-                            .x = 0u,
-                            .y = 0u
-                        },
-                        .extent = surfaceCap.currentExtent
-                    };
-                    // clear values corresponding to attachment indices with CLEAR loadOp are used
-                    ci.clearValueCount = attachmentClearValues.size();
-                    ci.pClearValues = attachmentClearValues.data();
-                }
-            }
-            vkCmdBeginRenderPass(cbs[i], &(renderPassBeginInfos[i]), VK_SUBPASS_CONTENTS_INLINE);
-        // bind pipeline to command buffer of queue 0
-            vkCmdBindPipeline(cbs[i], VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
-        // draw call
-            vkCmdDraw(cbs[i], 3, 1, 0, 0);
-        // end render pass
-            vkCmdEndRenderPass(cbs[i]);
-        // Command buffer: Recording -> Executable
-            vkEndCommandBuffer(cbs[i]);
-        }
-    }
-// Step 4: Create semaphores and fences
-// - imageAvailableSemaphores : in-GPU sync, an image has been acquired and is ready for rendering
-// - renderFinishedSemaphores : in-GPU sync, rendering has finished and presentation can happen
-// - execFences: CPU-GPU sync, one render execution ends and the host can begin a new frame
-    {
-    // use queue family 0 for graphics pipeline
-        auto& cbs = commandBuffers[0];
-        VkSemaphoreCreateInfo semaphoreCreateInfo;
-        VkFenceCreateInfo fenceCreateInfo;
-        {
-            auto& ci = semaphoreCreateInfo;
-            ci.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
-            ci.pNext = nullptr;
-            ci.flags = 0;
+// Command buffer: Initial -> Recording
+    vkBeginCommandBuffer(cb, &commandBufferBeginInfo);
+    gpuProfiler.beginFrame(cb, frameIdx);
+    uploadWaitValue = uploader.recordAcquires(cb);
+// complete once its acquire is recorded (just above at the latest), until then the pass only clears
+    bool geometryReady = uploader.complete(vertexTicket);
+    if (cfg.asyncCompute) {
+        asyncCompute.acquire(cb, frameIdx);
+    }
+// begin render pass, background follows the simulated hue (dimmed)
+    ScratchArena::Scope scope(scratch);
+    ScratchVector<VkClearValue> attachmentClearValues(scratch, attachments.size());
+    attachmentClearValues.resize(attachments.size());
+    for (auto& el : attachmentClearValues) {
+        float rgb[3];
+        hueToRgb(sceneState.hue, rgb);
+        for (size_t i = 0; i < 3; ++i) {
+            el.color.float32[i] = 0.1f * rgb[i];
         }
-        {
-            auto& ci = fenceCreateInfo;
-            ci.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
-            ci.pNext = nullptr;
-            // created in signaled state
-            ci.flags = VK_FENCE_CREATE_SIGNALED_BIT;
+        el.color.float32[3] = 1.0f;
+    }
+    VkRenderPassBeginInfo renderPassBeginInfo;
+    {
+        auto& ci = renderPassBeginInfo;
+        ci.sType = VK_STRUCTURE_TYPE_RENDER_PASS_BEGIN_INFO;
+        ci.pNext = nullptr;
+        ci.renderPass = renderPass;
+        ci.framebuffer = framebuffers[imageIdx];
+        ci.renderArea = VkRect2D {
+            .offset = VkOffset2D {
+                .x = 0u,
+                .y = 0u
+            },
+            .extent = swapchainExtent
+        };
+        // clear values corresponding to attachment indices with CLEAR loadOp are used
+        ci.clearValueCount = attachmentClearValues.size();
+        ci.pClearValues = attachmentClearValues.data();
+    }
+// draw calls of the selected scene: cached mode executes the buckets' prerecorded
+// secondaries; per frame, long draw lists are recorded in parallel into secondaries,
+// short ones inline where the fan-out would cost more than it saves
+    bool cached = geometryReady && cfg.recordMode == "cached";
+    bool parallel = geometryReady && !cached && jobSystem.threadCount() > 1 && drawList.size() >= 2 * cfg.recordChunkSize;
+    if (cached) {
+        recordBuckets();
+    } else if (parallel) {
+        recordSecondaryCommandBuffers(imageIdx);
+    }
+    uint32_t mainPassScope = gpuProfiler.beginScope(cb, frameIdx, "mainPass");
+    if (cached || parallel) {
+        vkCmdBeginRenderPass(cb, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_SECONDARY_COMMAND_BUFFERS);
+        if (!secondaryCommandBuffers.empty()) {
+            vkCmdExecuteCommands(cb, secondaryCommandBuffers.size(), secondaryCommandBuffers.data());
         }
-        imageAvailableSemaphores.resize(cbs.size());
-        renderFinishedSemaphores.resize(cbs.size());
-        execFences.resize(cbs.size());
-        for (uint32_t i = 0; i < cbs.size(); ++i) {
-            VkResult r = vkCreateSemaphore(device, &semaphoreCreateInfo, nullptr, &(imageAvailableSemaphores[i]));
-            if (r != VK_SUCCESS) throw std::runtime_error(std::format("vkCreateSemaphore: {}", (int)r));
-            r = vkCreateSemaphore(device, &semaphoreCreateInfo, nullptr, &(renderFinishedSemaphores[i]));
-            if (r != VK_SUCCESS) throw std::runtime_error(std::format("vkCreateSemaphore: {}", (int)r));
-            r = vkCreateFence(device, &fenceCreateInfo, nullptr, &(execFences[i]));
-            if (r != VK_SUCCESS) throw std::runtime_error(std::format("vkCreateFence: {}", (int)r));
+    } else {
+        vkCmdBeginRenderPass(cb, &renderPassBeginInfo, VK_SUBPASS_CONTENTS_INLINE);
+        if (geometryReady) {
+            recordDraws(cb, 0, drawList.size());
         }
     }
+// end render pass
+    vkCmdEndRenderPass(cb);
+    gpuProfiler.endScope(cb, frameIdx, mainPassScope);
+// Command buffer: Recording -> Executable
+    VkResult r = vkEndCommandBuffer(cb);
+    if (r != VK_SUCCESS) throw std::runtime_error(std::format("vkEndCommandBuffer: {}", (int)r));
+}
+
+void Vulkan::buildImageSyncs ()
+{
+// renderFinishedSemaphores : one per swapchain image, since presentation of an image
+//                            may still be pending when a later frame reuses the same FrameContext
+// imagesInFlight : no image is in use when (re)built, device is idle or fresh
+    VkSemaphoreCreateInfo semaphoreCreateInfo;
+    {
+        auto& ci = semaphoreCreateInfo;
+        ci.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+        ci.pNext = nullptr;
+        ci.flags = 0;
+    }
+    while (renderFinishedSemaphores.size() > swapchainImages.size()) {
+        vkDestroySemaphore(device, renderFinishedSemaphores.back(), nullptr);
+        renderFinishedSemaphores.pop_back();
+    }
+    while (renderFinishedSemaphores.size() < swapchainImages.size()) {
+        VkSemaphore semaphore;
+        VkResult r = vkCreateSemaphore(device, &semaphoreCreateInfo, nullptr, &semaphore);
+        if (r != VK_SUCCESS) throw std::runtime_error(std::format("vkCreateSemaphore: {}", (int)r));
+        renderFinishedSemaphores.push_back(semaphore);
+    }
+    imagesInFlight.assign(swapchainImages.size(), VK_NULL_HANDLE);
+}
+
+void Vulkan::updateSimulation ()
+{
+    uint32_t steps = simClock.advance();
+    for (uint32_t i = 0; i < steps; ++i) {
+        simulation.step(simClock.stepSeconds());
+    }
+    sceneState = simulation.interpolate(simClock.alpha());
 }
 
 void Vulkan::render ()
 {
     {
-        static std::chrono::time_point<std::chrono::system_clock, std::chrono::milliseconds> lastFrameStartTime;
-        auto thisFrameStartTime = std::chrono::time_point_cast<std::chrono::milliseconds>(std::chrono::system_clock::now());
-        [[maybe_unused]] auto frameTime = thisFrameStartTime - lastFrameStartTime;
-
-    // use queue family 0 queue 0 for graphics pipeline
-        auto& cbs = commandBuffers[0];
-        auto& q = deviceQueues[0][0];
-        // we have a pool of semaphores or fences for each sync purpose, 
-        // out of each pool, use one at a time (pool size no less than amount of images)
-        static uint32_t syncIdx = 0;
+        auto thisFrameStartTime = Telemetry::now();
+        Telemetry::FrameSample sample;
+        updateSimulation();
+
+        auto& q = graphicsQueue.queue;
+        // resources of this frame are free again once its previous submission has completed
+        auto& frame = frames[frameIdx];
         // correct image (canvas) to use this frame, told by swapchain later
         uint32_t imageIdx = -1;
-        vkWaitForFences(device, 1, &(execFences[syncIdx]), VK_TRUE, std::numeric_limits<uint64_t>::max());
-        vkResetFences(device, 1, &(execFences[syncIdx]));
+        // rebuild after resize / OUT_OF_DATE, skip this frame while minimized
+        if (swapchainDirty) {
+            rebuildSwapchain();
+            if (swapchainDirty) {
+                lastFrameStartTime = Telemetry::Clock::time_point();
+                return;
+            }
+        }
+        // first frame after a (re)build: block on the pipelines this frame draws with only
+        if (pipeline == VK_NULL_HANDLE) {
+            pipeline = pipelines.wait(trianglePipelines[triangleVariant]);
+        }
+        auto t = Telemetry::now();
+        vkWaitForFences(device, 1, &(frame.execFence), VK_TRUE, std::numeric_limits<uint64_t>::max());
+        sample.ns[Telemetry::FenceWait] = Telemetry::since(t);
         // acquire (occupy) an available image to draw on
-        vkAcquireNextImageKHR(device, swapchain,
-            std::numeric_limits<uint64_t>::max(), 
-            imageAvailableSemaphores[syncIdx],
-            VK_NULL_HANDLE, &imageIdx);
+        // headless: offscreen images are simply used round-robin
+        t = Telemetry::now();
+        VkResult r = VK_SUCCESS;
+        if (cfg.headless) {
+            imageIdx = nextOffscreenImage;
+            nextOffscreenImage = (nextOffscreenImage + 1) % swapchainImages.size();
+        } else {
+            r = vkAcquireNextImageKHR(device, swapchain,
+                std::numeric_limits<uint64_t>::max(), 
+                frame.imageAvailableSemaphore,
+                VK_NULL_HANDLE, &imageIdx);
+        }
+        sample.ns[Telemetry::AcquireWait] = Telemetry::since(t);
+        // OUT_OF_DATE: nothing was acquired and the semaphore is unsignaled, fence is not reset yet so just retry next frame
+        // SUBOPTIMAL: the image is still presentable, render it and rebuild afterwards
+        if (r == VK_ERROR_OUT_OF_DATE_KHR) {
+            swapchainDirty = true;
+            lastFrameStartTime = Telemetry::Clock::time_point();
+            return;
+        } else if (r == VK_SUBOPTIMAL_KHR) {
+            swapchainDirty = true;
+        } else if (r != VK_SUCCESS) {
+            throw std::runtime_error(std::format("vkAcquireNextImageKHR: {}", (int)r));
+        }
+        // the image may be returned before the frame that last rendered to it has finished
+        // (image count != frames in flight), so wait on that frame's fence too
+        if (imagesInFlight[imageIdx] != VK_NULL_HANDLE && imagesInFlight[imageIdx] != frame.execFence) {
+            t = Telemetry::now();
+            vkWaitForFences(device, 1, &(imagesInFlight[imageIdx]), VK_TRUE, std::numeric_limits<uint64_t>::max());
+            sample.ns[Telemetry::FenceWait] += Telemetry::since(t);
+        }
+        imagesInFlight[imageIdx] = frame.execFence;
+        vkResetFences(device, 1, &(frame.execFence));
+        // last submission of this frame has completed: its timestamps are ready
+        // and its command pool can be recycled
+        sample.ns[Telemetry::GpuFrame] = gpuProfiler.collect(device, frameIdx);
+        // memory budget: caches evict before the heaps overcommit
+        allocator.updateBudget();
+        for (uint32_t i = 0; i < allocator.heapCount() && i < Telemetry::maxHeaps; ++i) {
+            telemetry.setHeap(i, allocator.budgets()[i].usage, allocator.budgets()[i].budget);
+        }
+        t = Telemetry::now();
+        // kick off culling first so the compute queue runs while graphics is recorded
+        if (cfg.asyncCompute) {
+            asyncCompute.upload(device, frameIdx, drawList, drawListVersion);
+            asyncCompute.submit(device, computeQueue.queue, frameIdx, drawList.size());
+        }
+        uploader.pump(device, VkDeviceSize(cfg.uploadBudgetKb) << 10);
+        frameArena.beginFrame(frameIdx);
+        if (bindless.enabled()) {
+            bindless.beginFrame(frameIdx);
+        }
+        {
+            FrameUniforms uniforms = {};
+            float angle = static_cast<float>(sceneState.time * 0.5);
+            uniforms.rotation[0] = std::cos(angle);
+            uniforms.rotation[1] = -std::sin(angle);
+            uniforms.rotation[2] = std::sin(angle);
+            uniforms.rotation[3] = std::cos(angle);
+            uniforms.time = static_cast<float>(sceneState.time);
+            uniforms.hue = sceneState.hue;
+            frameUniformOffset = frameArena.push(uniforms);
+        }
+        vkResetCommandPool(device, frame.commandPool, 0);
+        secondaryRecorder.reset(device, frameIdx);
+        recordCommandBuffer(frame.commandBuffer, imageIdx);
+        sample.ns[Telemetry::Record] = Telemetry::since(t);
         // submit command buffer to queue (once per frame)
         VkSubmitInfo submitInfo;
         // "dst" means mask out: which stages need to wait
-        VkPipelineStageFlags waitDstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+        // the acquired image before color output, the culling results before indirect draws
+        // uploads acquired this frame: their timeline value is already reached, the wait only orders memory
+        std::array<VkSemaphore, 3> waitSemaphores;
+        std::array<VkPipelineStageFlags, 3> waitDstStageMasks;
+        std::array<uint64_t, 3> waitValues = {};
+        uint32_t waitCnt = 0;
+        if (!cfg.headless) {
+            waitSemaphores[waitCnt] = frame.imageAvailableSemaphore;
+            waitDstStageMasks[waitCnt++] = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
+        }
+        if (cfg.asyncCompute) {
+            waitSemaphores[waitCnt] = asyncCompute.done(frameIdx);
+            waitDstStageMasks[waitCnt++] = VK_PIPELINE_STAGE_DRAW_INDIRECT_BIT;
+        }
+        if (uploadWaitValue != 0) {
+            waitSemaphores[waitCnt] = uploader.timeline();
+            waitValues[waitCnt] = uploadWaitValue;
+            waitDstStageMasks[waitCnt++] = VK_PIPELINE_STAGE_ALL_COMMANDS_BIT;
+        }
+        // values of binary semaphores are ignored
+        VkTimelineSemaphoreSubmitInfo timelineSubmitInfo;
+        {
+            auto& si = timelineSubmitInfo;
+            si.sType = VK_STRUCTURE_TYPE_TIMELINE_SEMAPHORE_SUBMIT_INFO;
+            si.pNext = nullptr;
+            si.waitSemaphoreValueCount = waitCnt;
+            si.pWaitSemaphoreValues = waitValues.data();
+            si.signalSemaphoreValueCount = 0;
+            si.pSignalSemaphoreValues = nullptr;
+        }
         {
             auto& si = submitInfo;
             si.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-            si.pNext = nullptr;
-            si.waitSemaphoreCount = 1;
-            si.pWaitSemaphores = &(imageAvailableSemaphores[syncIdx]);
-            si.pWaitDstStageMask = &waitDstStageMask;
+            si.pNext = &timelineSubmitInfo;
+            si.waitSemaphoreCount = waitCnt;
+            si.pWaitSemaphores = waitSemaphores.data();
+            si.pWaitDstStageMask = waitDstStageMasks.data();
             si.commandBufferCount = 1;
-            si.pCommandBuffers = &cbs[imageIdx];
-            si.signalSemaphoreCount = 1;
-            si.pSignalSemaphores = &renderFinishedSemaphores[imageIdx];
+            si.pCommandBuffers = &(frame.commandBuffer);
+            si.signalSemaphoreCount = cfg.headless ? 0 : 1;
+            si.pSignalSemaphores = &(renderFinishedSemaphores[imageIdx]);
         }
         // execFence is signaled when submitted command buffers have completed execution
         // command buffer state: Executable --submitted-> Pending(occupied) 
         //                                <-exec complete--      <if set one-time> --complete-> Invalid
-        vkQueueSubmit(q, 1, &submitInfo, execFences[syncIdx]);
-        VkPresentInfoKHR presentInfo;
-        // ask queue to present to swapchain image
-        {
-            auto& pi = presentInfo;
-            pi.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
-            pi.pNext = nullptr;
-            pi.waitSemaphoreCount = 1;
-            pi.pWaitSemaphores = &(renderFinishedSemaphores[syncIdx]);
-            pi.swapchainCount = 1;
-            pi.pSwapchains = &swapchain;
-            pi.pImageIndices = &imageIdx;
-            pi.pResults = nullptr;
-        }
-        // release the image in use and present to platform display engine
-        vkQueuePresentKHR(q, &presentInfo);
-        syncIdx = (syncIdx + 1) % cbs.size();
+        t = Telemetry::now();
+        r = vkQueueSubmit(q, 1, &submitInfo, frame.execFence);
+        if (r != VK_SUCCESS) throw std::runtime_error(std::format("vkQueueSubmit: {}", (int)r));
+        // nothing to present in headless mode
+        if (!cfg.headless) {
+            VkPresentInfoKHR presentInfo;
+            // ask queue to present to swapchain image
+            {
+                auto& pi = presentInfo;
+                pi.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR;
+                pi.pNext = nullptr;
+                pi.waitSemaphoreCount = 1;
+                pi.pWaitSemaphores = &(renderFinishedSemaphores[imageIdx]);
+                pi.swapchainCount = 1;
+                pi.pSwapchains = &swapchain;
+                pi.pImageIndices = &imageIdx;
+                pi.pResults = nullptr;
+            }
+            // release the image in use and present to platform display engine
+            r = vkQueuePresentKHR(q, &presentInfo);
+            if (r == VK_ERROR_OUT_OF_DATE_KHR || r == VK_SUBOPTIMAL_KHR) {
+                swapchainDirty = true;
+            } else if (r != VK_SUCCESS) {
+                throw std::runtime_error(std::format("vkQueuePresentKHR: {}", (int)r));
+            }
+        }
+        sample.ns[Telemetry::SubmitPresent] = Telemetry::since(t);
+        frameIdx = (frameIdx + 1) % frames.size();
+        // first frame (and the first after minimize / OUT_OF_DATE) has no predecessor, no interval
+        if (lastFrameStartTime != Telemetry::Clock::time_point()) {
+            sample.ns[Telemetry::CpuFrame] = std::chrono::duration_cast<std::chrono::nanoseconds>(thisFrameStartTime - lastFrameStartTime).count();
+        } else {
+            sample.missing |= 1u << Telemetry::CpuFrame;
+        }
+        // no timestamps yet (first frames in flight, results not ready, no timestamp support)
+        if (sample.ns[Telemetry::GpuFrame] == 0) {
+            sample.missing |= 1u << Telemetry::GpuFrame;
+        }
         lastFrameStartTime = thisFrameStartTime;
+        telemetry.push(sample);
+        if (telemetry.tick()) {
+            gpuProfiler.report();
+        }
     }  
 }
 
+std::vector<char> Vulkan::readBuffer (VkBuffer src, VkDeviceSize size)
+{
+    vkDeviceWaitIdle(device);
+// Step 1: Host-visible destination
+    VkBuffer dst;
+    GpuAllocation dstAllocation;
+    {
+        VkBufferCreateInfo bufferCreateInfo;
+        auto& ci = bufferCreateInfo;
+        ci.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+        ci.pNext = nullptr;
+        ci.flags = 0;
+        ci.size = size;
+        ci.usage = VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+        ci.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        ci.queueFamilyIndexCount = 0;
+        ci.pQueueFamilyIndices = nullptr;
+        dst = allocator.createBuffer(ci, MemoryUsage::Readback, dstAllocation);
+    }
+// Step 2: One-off copy on the graphics queue, a transient pool of its own
+    VkCommandPool commandPool;
+    {
+        VkCommandPoolCreateInfo commandPoolCreateInfo;
+        auto& ci = commandPoolCreateInfo;
+        ci.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+        ci.pNext = nullptr;
+        ci.flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+        ci.queueFamilyIndex = graphicsQueue.family;
+        VkResult r = vkCreateCommandPool(device, &ci, nullptr, &commandPool);
+        if (r != VK_SUCCESS) throw std::runtime_error(std::format("vkCreateCommandPool: {}", (int)r));
+    }
+    VkCommandBuffer cb;
+    {
+        VkCommandBufferAllocateInfo commandBufferAllocateInfo;
+        auto& ai = commandBufferAllocateInfo;
+        ai.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+        ai.pNext = nullptr;
+        ai.commandPool = commandPool;
+        ai.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+        ai.commandBufferCount = 1;
+        VkResult r = vkAllocateCommandBuffers(device, &ai, &cb);
+        if (r != VK_SUCCESS) throw std::runtime_error(std::format("vkAllocateCommandBuffers: {}", (int)r));
+    }
+    VkCommandBufferBeginInfo commandBufferBeginInfo;
+    {
+        auto& ci = commandBufferBeginInfo;
+        ci.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+        ci.pNext = nullptr;
+        ci.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+        ci.pInheritanceInfo = nullptr;
+    }
+    vkBeginCommandBuffer(cb, &commandBufferBeginInfo);
+    VkBufferCopy region = { 0, 0, size };
+    vkCmdCopyBuffer(cb, src, dst, 1, &region);
+// make the copy visible to host reads
+    VkMemoryBarrier barrier;
+    barrier.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER;
+    barrier.pNext = nullptr;
+    barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+    barrier.dstAccessMask = VK_ACCESS_HOST_READ_BIT;
+    vkCmdPipelineBarrier(cb, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_HOST_BIT, 0, 1, &barrier, 0, nullptr, 0, nullptr);
+    VkResult r = vkEndCommandBuffer(cb);
+    if (r != VK_SUCCESS) throw std::runtime_error(std::format("vkEndCommandBuffer: {}", (int)r));
+    VkSubmitInfo submitInfo;
+    {
+        auto& si = submitInfo;
+        si.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+        si.pNext = nullptr;
+        si.waitSemaphoreCount = 0;
+        si.pWaitSemaphores = nullptr;
+        si.pWaitDstStageMask = nullptr;
+        si.commandBufferCount = 1;
+        si.pCommandBuffers = &cb;
+        si.signalSemaphoreCount = 0;
+        si.pSignalSemaphores = nullptr;
+    }
+    r = vkQueueSubmit(graphicsQueue.queue, 1, &submitInfo, VK_NULL_HANDLE);
+    if (r != VK_SUCCESS) throw std::runtime_error(std::format("vkQueueSubmit: {}", (int)r));
+    vkQueueWaitIdle(graphicsQueue.queue);
+    vkDestroyCommandPool(device, commandPool, nullptr);
+// Step 3: Read, the memory may not be host coherent
+    VkMappedMemoryRange range;
+    range.sType = VK_STRUCTURE_TYPE_MAPPED_MEMORY_RANGE;
+    range.pNext = nullptr;
+    range.memory = dstAllocation.memory;
+    range.offset = dstAllocation.offset / physicalDeviceProperties.limits.nonCoherentAtomSize * physicalDeviceProperties.limits.nonCoherentAtomSize;
+    range.size = VK_WHOLE_SIZE;
+    vkInvalidateMappedMemoryRanges(device, 1, &range);
+    std::vector<char> data(size);
+    std::memcpy(data.data(), dstAllocation.mapped, size);
+    allocator.destroyBuffer(dst, dstAllocation);
+    return data;
+}
+
 Vulkan::~Vulkan ()
 {
-    vkDestroySwapchainKHR(device, swapchain, nullptr);
-    vkDestroySurfaceKHR(instance, surface, nullptr);
-    // After destroying all objs created with device, wait idle and destroy it
+    // Wait for in-flight frames before destroying anything they may still use
     vkDeviceWaitIdle(device);
+    gpuProfiler.report();
+    gpuProfiler.destroy(device);
+    secondaryRecorder.destroy(device);
+    bucketCache.destroy(device);
+    asyncCompute.destroy(device);
+    uploader.destroy(device);
+    for (auto& frame : frames) {
+        frame.destroy(device);
+    }
+    for (auto& el : renderFinishedSemaphores) {
+        vkDestroySemaphore(device, el, nullptr);
+    }
+    for (auto& el : framebuffers) {
+        vkDestroyFramebuffer(device, el, nullptr);
+    }
+    pipelines.destroy();
+    vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
+    for (auto& el : shaderModules) {
+        vkDestroyShaderModule(device, el, nullptr);
+    }
+    vkDestroyRenderPass(device, renderPass, nullptr);
+    for (auto& el : swapchainImageViews) {
+        vkDestroyImageView(device, el, nullptr);
+    }
+    if (cfg.headless) {
+        destroyOffscreenImages();
+    } else {
+        vkDestroySwapchainKHR(device, swapchain, nullptr);
+        vkDestroySurfaceKHR(instance, surface, nullptr);
+    }
+    pipelineCache.save();
+    pipelineCache.destroy();
+    allocator.destroyBuffer(vertexBuffer, vertexAllocation);
+    if (materialBuffer != VK_NULL_HANDLE) {
+        allocator.destroyBuffer(materialBuffer, materialAllocation);
+    }
+    bindless.destroy();
+    frameArena.destroy(device);
+    allocator.logStats();
+    allocator.destroy();
     vkDestroyDevice(device, nullptr);
     vkDestroyInstance(instance, nullptr);
 }
 
 Vulkan::Vulkan (std::vector<const char*> additionalInctanceExtensions, Config& cfg)
-: cfg (cfg)
+: cfg (cfg),
+  scene (findScene(cfg.scene)),
+  drawList (buildDrawList(scene)),
+  scratch (scratchArenaSize),
+  jobSystem (cfg.jobWorkers, cfg.jobAffinity),
+  telemetry (cfg),
+  simClock (cfg.simRate, cfg.simMaxCatchUp)
 {
     logInfo("Initializing Vulkan ...");
+// hueTint only picks the variant the first frame uses, the others are compiled too
+    if (cfg.hueTint) {
+        triangleVariant |= 1u << HueTint;
+    }
+// built-in scenes only fill StaticWorld, the other buckets start empty behind it
+    buckets[StaticWorld] = BucketRange { 0, drawList.size(), hashDraws(drawList.data(), drawList.size()) };
+    for (uint32_t i = StaticWorld + 1; i < BucketCount; ++i) {
+        buckets[i].first = drawList.size();
+    }
 
     instanceEnabledExtensionNames.insert(instanceEnabledExtensionNames.end(), additionalInctanceExtensions.begin(), additionalInctanceExtensions.end());
-    createInstance();
-    selectPhysicalDevice();
+    addOptionalInstanceExtensions();
+    timedPhase("createInstance", [this] { createInstance(); });
+    timedPhase("selectPhysicalDevice", [this] { selectPhysicalDevice(); });
     logInfo(std::format("Selected phy device: {}", physicalDeviceProperties.deviceName));
 
-    createDevice();
-    getDeviceQueues();
+    timedPhase("createDevice", [this] { createDevice(); getDeviceQueues(); allocator.init(selectedPhysicalDevice, device, deviceExtensionEnabled(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME)); });
+    pipelineCache.init(device, physicalDeviceProperties, cfg.pipelineCache.empty() ? std::string() : cfg.rootDir + "/" + cfg.pipelineCache);
+    pipelines.init(device, jobSystem, pipelineCache.get());
+    frameArena.init(device, physicalDeviceProperties, allocator, cfg.framesInFlight, VkDeviceSize(cfg.frameArenaKb) << 10);
+    if (descriptorIndexing) {
+        bindless.init(selectedPhysicalDevice, device, cfg.framesInFlight);
+        createMaterialBuffer();
+    } else {
+        std::cerr << "[Warning] descriptor indexing not supported, bindless table disabled" << std::endl;
+    }
     logInfo(std::format("Queue family count: {}", queueFamilyProperties.size()));
     for (uint32_t i = 0; i < queueFamilyProperties.size(); ++i) {
-        logInfo(std::format("- Queue family {}, queue count: {}", i, queueFamilyProperties[i].queueCount));
+        logInfo(std::format("- Queue family {}, queue count: {}, flags: {:#x}", i, queueFamilyProperties[i].queueCount, queueFamilyProperties[i].queueFlags));
     }
+    logInfo(std::format("Memory budget: {}", deviceExtensionEnabled(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME) ? VK_EXT_MEMORY_BUDGET_EXTENSION_NAME : "estimated from heap sizes"));
+    logInfo(std::format("Queues: graphics {}.{}, compute {}.{}, transfer {}.{}",
+        graphicsQueue.family, graphicsQueue.index, computeQueue.family, computeQueue.index, transferQueue.family, transferQueue.index));
     logInfo("Vulkan initialized");
 }
@@ -10,37 +10,159 @@
 #include <algorithm>
 #include <memory>
 #include <limits>
+#include <cstring>
+#include <cstddef>
+#include <array>
 #include "utils.h"
 #include "Config.h"
+#include "FrameContext.h"
+#include "Telemetry.h"
+#include "GpuProfiler.h"
+#include "Scene.h"
+#include "SimClock.h"
+#include "Simulation.h"
+#include "JobSystem.h"
+#include "SecondaryRecorder.h"
+#include "BucketCache.h"
+#include "AsyncCompute.h"
+#include "Uploader.h"
+#include "GpuAllocator.h"
+#include "FrameArena.h"
+#include "ScratchArena.h"
+#include "BindlessTable.h"
+#include "PipelineCache.h"
+#include "PipelineRegistry.h"
 
 class Vulkan
 {
 private:
     [[maybe_unused]] Config& cfg;
+    const SceneDesc& scene;
+    std::vector<DrawCmd> drawList;
+// drawList is laid out bucket after bucket in RenderBucket order, hash identifies the range's draws
+    struct BucketRange {
+        size_t first = 0;
+        size_t cnt = 0;
+        uint64_t hash = 0;
+    };
+    std::array<BucketRange, BucketCount> buckets;
+// bumped whenever the pipeline is (re)built, invalidates all cached bucket secondaries
+    uint64_t pipelineGeneration = 0;
+// bumped whenever drawList changes, GPU-side copies (async compute input) follow it
+    uint64_t drawListVersion = 0;
+// all device memory (buffers, offscreen images, staging) is sub-allocated from here
+    GpuAllocator allocator;
+// temporaries of init, swapchain rebuild and per-frame paths (create infos, clear values), render thread only
+    static constexpr size_t scratchArenaSize = 256 << 10;
+    ScratchArena scratch;
+// per-frame uniform / storage data, bound as set 0 with a dynamic offset
+    FrameArena frameArena;
+// set 0 binding 0 of the triangle shaders (std140), pushed first into each frame's arena slice
+    struct FrameUniforms {
+    // 2x2 rotation of the scene, rows (cos, -sin) and (sin, cos)
+        float rotation[4];
+        float time;
+        float hue;
+        float pad[2];
+    };
+    uint32_t frameUniformOffset = 0;
+// global descriptor-indexing table, set 1, addressed through pushed handles (when supported)
+    BindlessTable bindless;
+    bool descriptorIndexing = false;
+    BindlessTable::Handles drawHandles;
+// material of the triangle (rgb scale), read by triangle.bindless.frag through drawHandles.buffer
+    VkBuffer materialBuffer = VK_NULL_HANDLE;
+    GpuAllocation materialAllocation;
+// shared by every pipeline creation, persisted under cfg.rootDir between runs
+    PipelineCache pipelineCache;
+// all pipelines, compiled in parallel on the job system; pipeline is taken from it
+// once the first frame needs it
+    PipelineRegistry pipelines;
+// triangle geometry, streamed in through the uploader; frames only clear until it has arrived
+    struct Vertex {
+        float position[2];
+        float color[3];
+    };
+    VkBuffer vertexBuffer = VK_NULL_HANDLE;
+    GpuAllocation vertexAllocation;
+    Uploader::Ticket vertexTicket = 0;
+// specialization constants of the triangle shaders (constant_id), one pipeline per combination
+    enum TriangleConstant : uint32_t {
+        Rotate = 0,
+        HueTint,
+        TriangleConstantCount
+    };
+// variant bits (bit c: constant c on) -> pipeline; all variants are compiled at init,
+// switching between them at runtime only rebinds
+    std::array<PipelineRegistry::Id, 1u << TriangleConstantCount> trianglePipelines = {};
+    uint32_t triangleVariant = 1u << Rotate;
+// culling on the compute queue, feeds indirect draws (cfg.asyncCompute)
+    AsyncCompute asyncCompute;
+// streaming uploads on the transfer queue, pumped once per frame within cfg.uploadBudgetKb
+    Uploader uploader;
+// timeline value of the uploads acquired by the frame being recorded, waited on by its submission
+    uint64_t uploadWaitValue = 0;
+// engine-wide worker threads, e.g. parallel recording of drawList into secondary command buffers
+    JobSystem jobSystem;
+    SecondaryRecorder secondaryRecorder;
+    std::vector<VkCommandBuffer> secondaryCommandBuffers;
+    BucketCache bucketCache;
+    Telemetry telemetry;
+    GpuProfiler gpuProfiler;
+// fixed-timestep simulation, stepped at the start of each render()
+    SimClock simClock;
+    Simulation simulation;
+    Simulation::State sceneState;
+// wall time of each init step in ns, in execution order
+    std::vector<std::pair<std::string, uint64_t>> initPhases;
+    Telemetry::Clock::time_point lastFrameStartTime;
 // Handles
     VkInstance instance;
     VkDevice device;
-    VkSurfaceKHR surface;
-    VkSwapchainKHR swapchain;
+    VkSurfaceKHR surface = VK_NULL_HANDLE;
+    VkSwapchainKHR swapchain = VK_NULL_HANDLE;
     std::vector<std::vector<VkQueue>> deviceQueues;
     std::vector<VkImage> swapchainImages;
     std::vector<VkImageView> swapchainImageViews;
-    VkRenderPass renderPass;
+// headless only, backing memory of swapchainImages
+    std::vector<GpuAllocation> offscreenImageAllocations;
+    uint32_t nextOffscreenImage = 0;
+    VkRenderPass renderPass = VK_NULL_HANDLE;
     std::vector<VkShaderModule> shaderModules;
-    VkPipeline pipeline;
+    VkPipeline pipeline = VK_NULL_HANDLE;
     std::vector<VkFramebuffer> framebuffers;
-    std::vector<VkCommandPool> commandPools;
-// dim: queueFamilyInUse.size() * framebuffers.size()
-    std::vector<std::vector<VkCommandBuffer>> commandBuffers;
 // Pre-defineds
-    std::vector<const char*> instanceEnabledExtensionNames = {"VK_KHR_portability_enumeration"};
-    std::vector<const char*> deviceEnabledExtensionNames = {"VK_KHR_portability_subset", VK_KHR_SWAPCHAIN_EXTENSION_NAME};
-    std::vector<uint32_t> queueFamilyInUse = {0};
+    std::vector<const char*> instanceEnabledExtensionNames = {};
+    std::vector<const char*> deviceEnabledExtensionNames = {};
+// enabled only if reported by the loader / device (e.g. absent on lavapipe)
+    std::vector<const char*> instanceOptionalExtensionNames = {"VK_KHR_portability_enumeration"};
+    std::vector<const char*> deviceOptionalExtensionNames = {"VK_KHR_portability_subset", VK_EXT_MEMORY_BUDGET_EXTENSION_NAME};
+// Queue topology: family / queue index per role, picked by capability flags in selectQueueTopology.
+// Roles share a family (and a queue) when the device has nothing better, e.g. lavapipe: all on family 0.
+    struct QueueSlot {
+        uint32_t family = 0;
+        uint32_t index = 0;
+        VkQueue queue = VK_NULL_HANDLE;
+    };
+    QueueSlot graphicsQueue;
+    QueueSlot computeQueue;
+    QueueSlot transferQueue;
+// distinct families of the roles above, ascending
+    std::vector<uint32_t> queueFamilyInUse;
 // Useful infos
     VkPhysicalDevice selectedPhysicalDevice;
     VkSurfaceFormatKHR selectedSurfaceFormat;
+    VkPresentModeKHR selectedPresentMode = VK_PRESENT_MODE_FIFO_KHR;
     VkSurfaceCapabilitiesKHR surfaceCap;
+// drawable size of the window, used when the surface leaves the extent to the swapchain
+    VkExtent2D windowExtent = {0, 0};
+    VkExtent2D swapchainExtent = {0, 0};
+// set on resize / OUT_OF_DATE / SUBOPTIMAL, swapchain is rebuilt before the next frame
+    bool swapchainDirty = false;
     VkPhysicalDeviceProperties physicalDeviceProperties;
+// enabled at device creation, chained: enabledFeatures -> enabledVulkan12Features
+    VkPhysicalDeviceFeatures2 enabledFeatures;
+    VkPhysicalDeviceVulkan12Features enabledVulkan12Features;
     std::vector<VkQueueFamilyProperties> queueFamilyProperties;
     std::vector<VkAttachmentDescription> attachments;
 // For pipeline creation
@@ -55,23 +177,54 @@ private:
         VkPipelineColorBlendStateCreateInfo colorBlend;
         VkPipelineDynamicStateCreateInfo dynamic;
     } pipelineStateCreateInfos;
-    std::vector<VkViewport> viewports;
-    std::vector<VkRect2D> scissors;
     std::vector<VkPipelineColorBlendAttachmentState> colorBlendAttachmentStates;
+    std::vector<VkVertexInputBindingDescription> vertexBindingDescriptions;
+    std::vector<VkVertexInputAttributeDescription> vertexAttributeDescriptions;
+// viewport and scissor follow swapchainExtent at record time (recordDraws), so
+// a resize never rebuilds the pipeline
     std::vector<VkDynamicState> dynamicStates = {
-        //VK_DYNAMIC_STATE_VIEWPORT
+        VK_DYNAMIC_STATE_VIEWPORT,
+        VK_DYNAMIC_STATE_SCISSOR
     };
     std::vector<VkDescriptorSetLayout> descriptorSetLayout;
     std::vector<VkPushConstantRange> pushConstantRanges;
     VkPipelineLayoutCreateInfo pipelineLayoutCreateInfo;
-    VkPipelineLayout pipelineLayout;
-// Syncs
-    std::vector<VkSemaphore> imageAvailableSemaphores;
+    VkPipelineLayout pipelineLayout = VK_NULL_HANDLE;
+// Frames in flight
+    std::vector<FrameContext> frames;
+    uint32_t frameIdx = 0;
+// Syncs per swapchain image
+// - renderFinishedSemaphores : in-GPU sync, rendering to the image has finished and presentation can happen
+// - imagesInFlight : execFence of the frame that last rendered to the image (borrowed, not owned)
     std::vector<VkSemaphore> renderFinishedSemaphores;
-    std::vector<VkFence> execFences;
+    std::vector<VkFence> imagesInFlight;
 
 //    VkBufferCreateInfo vertexBufferCreateInfo;
 
+    inline void addOptionalInstanceExtensions ()
+    {
+        ScratchArena::Scope scope(scratch);
+        uint32_t extensionCnt = 0;
+        vkEnumerateInstanceExtensionProperties(nullptr, &extensionCnt, nullptr);
+        ScratchVector<VkExtensionProperties> supportedExtensions(scratch, extensionCnt);
+        supportedExtensions.resize(extensionCnt);
+        vkEnumerateInstanceExtensionProperties(nullptr, &extensionCnt, supportedExtensions.data());
+        for (auto& name : instanceOptionalExtensionNames) {
+            for (auto& el : supportedExtensions) {
+                if (std::strcmp(el.extensionName, name) == 0) {
+                    instanceEnabledExtensionNames.push_back(name);
+                    break;
+                }
+            }
+        }
+    }
+    inline bool isInstanceExtensionEnabled (const char* name)
+    {
+        for (auto& el : instanceEnabledExtensionNames) {
+            if (std::string(el) == name) return true;
+        }
+        return false;
+    }
     inline void createInstance()
     {
         VkInstanceCreateInfo instanceCreateInfo;
@@ -84,12 +237,13 @@ private:
             ai.applicationVersion = 1;
             ai.pEngineName = "Rxon";
             ai.engineVersion = 1;
-            ai.apiVersion = VK_API_VERSION_1_0;
+        // 1.2: timeline semaphores (Uploader)
+            ai.apiVersion = VK_API_VERSION_1_2;
         }
         auto& ci = instanceCreateInfo;
         ci.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO;
         ci.pNext = nullptr;
-        ci.flags = VK_INSTANCE_CREATE_ENUMERATE_PORTABILITY_BIT_KHR;
+        ci.flags = isInstanceExtensionEnabled("VK_KHR_portability_enumeration") ? VK_INSTANCE_CREATE_ENUMERATE_PORTABILITY_BIT_KHR : 0;
         ci.pApplicationInfo = &applicationInfo;
         ci.enabledLayerCount = 0;
         ci.ppEnabledLayerNames = {};
@@ -108,15 +262,21 @@ private:
             throw std::runtime_error("no physical device found");
         }
     // - Step 2: Get available elements
-        std::vector<VkPhysicalDevice> physicalDevices;
+        ScratchArena::Scope scope(scratch);
+        ScratchVector<VkPhysicalDevice> physicalDevices(scratch, physicalDevicesCnt);
         physicalDevices.resize(physicalDevicesCnt);
         vkEnumeratePhysicalDevices(instance, &physicalDevicesCnt, physicalDevices.data());
         selectedPhysicalDevice = physicalDevices[0];
         vkGetPhysicalDeviceProperties(selectedPhysicalDevice, &physicalDeviceProperties);
+        if (physicalDeviceProperties.apiVersion < VK_API_VERSION_1_2) {
+            throw std::runtime_error(std::format("{} supports Vulkan {}.{}, 1.2 is required", physicalDeviceProperties.deviceName,
+                VK_API_VERSION_MAJOR(physicalDeviceProperties.apiVersion), VK_API_VERSION_MINOR(physicalDeviceProperties.apiVersion)));
+        }
     }
     inline void createDevice ()
     {
     VkDeviceCreateInfo deviceCreateInfo;
+        ScratchArena::Scope scope(scratch);
     // Step 1: Get queue family info
         {
             uint32_t queueFamilyCnt = 0;
@@ -124,27 +284,74 @@ private:
             queueFamilyProperties.resize(queueFamilyCnt);
             vkGetPhysicalDeviceQueueFamilyProperties(selectedPhysicalDevice, &queueFamilyCnt, queueFamilyProperties.data());
         }
-    // Step 2: Prepare queue create info
-        std::vector<VkDeviceQueueCreateInfo> queueCreateInfos;
-        std::vector<std::vector<float>> queueFamilyPriorities;
-        queueCreateInfos.resize(queueFamilyProperties.size());
-        queueFamilyPriorities.resize(queueFamilyProperties.size());
+    // Step 2: Pick queues per role, create only those (per used family: up to the highest index in use)
+        selectQueueTopology();
+        ScratchVector<VkDeviceQueueCreateInfo> queueCreateInfos(scratch, queueFamilyInUse.size());
+        queueCreateInfos.resize(queueFamilyInUse.size());
         for (uint32_t i = 0; i < queueCreateInfos.size(); ++i) {
+            uint32_t family = queueFamilyInUse[i];
+            uint32_t queueCnt = 0;
+            for (auto slot : {&graphicsQueue, &computeQueue, &transferQueue}) {
+                if (slot->family == family) queueCnt = std::max(queueCnt, slot->index + 1);
+            }
             auto& ci = queueCreateInfos[i];
             ci.sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO;
             ci.pNext = nullptr;
             ci.flags = 0;
-            ci.queueFamilyIndex = i;
-            ci.queueCount = queueFamilyProperties[i].queueCount;
-            queueFamilyPriorities[i] = std::vector<float>(queueFamilyProperties[i].queueCount, 0.5);
-            ci.pQueuePriorities = queueFamilyPriorities[i].data();
+            ci.queueFamilyIndex = family;
+            ci.queueCount = queueCnt;
+            ScratchVector<float> priorities(scratch, queueCnt);
+            for (uint32_t j = 0; j < queueCnt; ++j) {
+                priorities.push_back(0.5f);
+            }
+            ci.pQueuePriorities = priorities.data();
+        }
+    // Step 3: Prepare extensions (swapchain only when presenting, portability subset when reported)
+        if (!cfg.headless) {
+            deviceEnabledExtensionNames.push_back(VK_KHR_SWAPCHAIN_EXTENSION_NAME);
+        }
+        {
+            uint32_t extensionCnt = 0;
+            vkEnumerateDeviceExtensionProperties(selectedPhysicalDevice, nullptr, &extensionCnt, nullptr);
+            ScratchVector<VkExtensionProperties> supportedExtensions(scratch, extensionCnt);
+            supportedExtensions.resize(extensionCnt);
+            vkEnumerateDeviceExtensionProperties(selectedPhysicalDevice, nullptr, &extensionCnt, supportedExtensions.data());
+            for (auto& name : deviceOptionalExtensionNames) {
+                for (auto& el : supportedExtensions) {
+                    if (std::strcmp(el.extensionName, name) == 0) {
+                        deviceEnabledExtensionNames.push_back(name);
+                        break;
+                    }
+                }
+            }
+        }
+    // Step 4: Features: all supported core ones, and the 1.2 ones the renderer relies on
+        {
+            VkPhysicalDeviceVulkan12Features supportedVulkan12Features = {};
+            supportedVulkan12Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+            VkPhysicalDeviceFeatures2 supportedFeatures = {};
+            supportedFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+            supportedFeatures.pNext = &supportedVulkan12Features;
+            vkGetPhysicalDeviceFeatures2(selectedPhysicalDevice, &supportedFeatures);
+            if (!supportedVulkan12Features.timelineSemaphore) {
+                throw std::runtime_error("timelineSemaphore feature not supported");
+            }
+            enabledVulkan12Features = {};
+            enabledVulkan12Features.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES;
+            enabledVulkan12Features.pNext = nullptr;
+            enabledVulkan12Features.timelineSemaphore = VK_TRUE;
+            descriptorIndexing = BindlessTable::supported(supportedVulkan12Features);
+            if (descriptorIndexing) {
+                BindlessTable::enableFeatures(enabledVulkan12Features);
+            }
+            enabledFeatures.sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2;
+            enabledFeatures.pNext = &enabledVulkan12Features;
+            enabledFeatures.features = supportedFeatures.features;
         }
-    // Step 3: Create device (implicitly created queues)
+    // Step 5: Create device (implicitly created queues)
         auto& ci = deviceCreateInfo;
-        VkPhysicalDeviceFeatures physicalDeviceFeatures;
-        vkGetPhysicalDeviceFeatures(selectedPhysicalDevice, &physicalDeviceFeatures);
         ci.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO;
-        ci.pNext = nullptr;
+        ci.pNext = &enabledFeatures;
         ci.flags = 0;
         ci.queueCreateInfoCount = queueCreateInfos.size();
         ci.pQueueCreateInfos = queueCreateInfos.data();
@@ -152,18 +359,65 @@ private:
         ci.ppEnabledLayerNames = nullptr;
         ci.enabledExtensionCount = deviceEnabledExtensionNames.size();
         ci.ppEnabledExtensionNames = deviceEnabledExtensionNames.data();
-        ci.pEnabledFeatures = &physicalDeviceFeatures;
+        // features come through pNext
+        ci.pEnabledFeatures = nullptr;
         VkResult r = vkCreateDevice(selectedPhysicalDevice, &ci, nullptr, &device);
         if (r != VK_SUCCESS) throw std::runtime_error(std::format("vkCreateDevice: {}", (int)r));
     }
+// graphics first, then a family with compute but no graphics (async compute),
+// then one with transfer only (DMA engine); each role falls back to the previous one.
+// Within a shared family a role gets its own queue while the family has spare ones.
+    inline void selectQueueTopology ()
+    {
+        auto find = [this] (VkQueueFlags required, VkQueueFlags excluded) -> int64_t {
+            for (uint32_t i = 0; i < queueFamilyProperties.size(); ++i) {
+                auto flags = queueFamilyProperties[i].queueFlags;
+                if ((flags & required) == required && (flags & excluded) == 0 && queueFamilyProperties[i].queueCount > 0) return i;
+            }
+            return -1;
+        };
+        ScratchArena::Scope scope(scratch);
+        ScratchVector<uint32_t> usedQueueCnt(scratch, queueFamilyProperties.size());
+        usedQueueCnt.resize(queueFamilyProperties.size());
+        auto assign = [&] (QueueSlot& slot, uint32_t family) {
+            slot.family = family;
+            slot.index = std::min(usedQueueCnt[family], queueFamilyProperties[family].queueCount - 1);
+            ++usedQueueCnt[family];
+        };
+        int64_t graphics = find(VK_QUEUE_GRAPHICS_BIT, 0);
+        if (graphics < 0) throw std::runtime_error("no graphics queue family");
+        assign(graphicsQueue, graphics);
+        int64_t compute = find(VK_QUEUE_COMPUTE_BIT, VK_QUEUE_GRAPHICS_BIT);
+        assign(computeQueue, compute >= 0 ? compute : graphics);
+        // graphics and compute queues implicitly support transfer
+        int64_t transfer = find(VK_QUEUE_TRANSFER_BIT, VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT);
+        assign(transferQueue, transfer >= 0 ? transfer : computeQueue.family);
+        queueFamilyInUse.clear();
+        for (auto slot : {&graphicsQueue, &computeQueue, &transferQueue}) {
+            if (std::find(queueFamilyInUse.begin(), queueFamilyInUse.end(), slot->family) == queueFamilyInUse.end()) {
+                queueFamilyInUse.push_back(slot->family);
+            }
+        }
+        std::sort(queueFamilyInUse.begin(), queueFamilyInUse.end());
+    }
+// deviceQueues[family][index], only queues created in createDevice
+    inline bool deviceExtensionEnabled (const char* name) const
+    {
+        for (auto& el : deviceEnabledExtensionNames) {
+            if (std::strcmp(el, name) == 0) return true;
+        }
+        return false;
+    }
     inline void getDeviceQueues () {
         deviceQueues.resize(queueFamilyProperties.size());
-        for (uint32_t i = 0; i < deviceQueues.size(); ++i) {
-            auto& sameFamilyQueues = deviceQueues[i];
-            sameFamilyQueues.resize(queueFamilyProperties[i].queueCount);
-            for (uint32_t j = 0; j < sameFamilyQueues.size(); ++j) {
-                vkGetDeviceQueue(device, i, j, sameFamilyQueues.data());
+        for (auto slot : {&graphicsQueue, &computeQueue, &transferQueue}) {
+            auto& sameFamilyQueues = deviceQueues[slot->family];
+            while (sameFamilyQueues.size() <= slot->index) {
+                VkQueue queue;
+                vkGetDeviceQueue(device, slot->family, sameFamilyQueues.size(), &queue);
+                sameFamilyQueues.push_back(queue);
             }
+            slot->queue = sameFamilyQueues[slot->index];
         }
     }
     inline void selectFormat ()
@@ -173,7 +427,8 @@ private:
         if (surfaceFormatCnt == 0) {
             throw std::runtime_error("no supported pixel format found");
         }
-        std::vector<VkSurfaceFormatKHR> supportedFormats;
+        ScratchArena::Scope scope(scratch);
+        ScratchVector<VkSurfaceFormatKHR> supportedFormats(scratch, surfaceFormatCnt);
         supportedFormats.resize(surfaceFormatCnt);
         VkResult r = vkGetPhysicalDeviceSurfaceFormatsKHR(selectedPhysicalDevice, surface, &surfaceFormatCnt, supportedFormats.data());
         if (r != VK_SUCCESS) throw std::runtime_error(std::format("vkGetPhysicalDeviceSurfaceFormatsKHR: {}", (int)r));
@@ -188,41 +443,100 @@ private:
             throw std::runtime_error("no compatible pixel format supported");
         }
     }
+    inline void selectPresentMode ()
+    {
+        uint32_t presentModeCnt = 0;
+        vkGetPhysicalDeviceSurfacePresentModesKHR(selectedPhysicalDevice, surface, &presentModeCnt, nullptr);
+        ScratchArena::Scope scope(scratch);
+        ScratchVector<VkPresentModeKHR> supportedPresentModes(scratch, presentModeCnt);
+        supportedPresentModes.resize(presentModeCnt);
+        VkResult r = vkGetPhysicalDeviceSurfacePresentModesKHR(selectedPhysicalDevice, surface, &presentModeCnt, supportedPresentModes.data());
+        if (r != VK_SUCCESS) throw std::runtime_error(std::format("vkGetPhysicalDeviceSurfacePresentModesKHR: {}", (int)r));
+    // fallback chain per requested mode, FIFO is the only mode guaranteed by the spec
+    //  - mailbox      : low latency without tearing, else immediate
+    //  - immediate    : uncapped with tearing, else mailbox
+    //  - fifo_relaxed : vsync that tears when late
+        ScratchVector<VkPresentModeKHR> candidates(scratch, 3);
+        if (cfg.presentMode == "mailbox") {
+            candidates.push_back(VK_PRESENT_MODE_MAILBOX_KHR);
+            candidates.push_back(VK_PRESENT_MODE_IMMEDIATE_KHR);
+        } else if (cfg.presentMode == "immediate") {
+            candidates.push_back(VK_PRESENT_MODE_IMMEDIATE_KHR);
+            candidates.push_back(VK_PRESENT_MODE_MAILBOX_KHR);
+        } else if (cfg.presentMode == "fifo_relaxed") {
+            candidates.push_back(VK_PRESENT_MODE_FIFO_RELAXED_KHR);
+        }
+        candidates.push_back(VK_PRESENT_MODE_FIFO_KHR);
+        for (auto& el : candidates) {
+            if (std::find(supportedPresentModes.begin(), supportedPresentModes.end(), el) != supportedPresentModes.end()) {
+                selectedPresentMode = el;
+                return;
+            }
+        }
+        selectedPresentMode = VK_PRESENT_MODE_FIFO_KHR;
+    }
+    inline uint32_t selectImageCount ()
+    {
+        uint32_t cnt = cfg.swapchainImageCount != 0 ? cfg.swapchainImageCount : std::max(surfaceCap.minImageCount, 2u);
+        cnt = std::max(cnt, surfaceCap.minImageCount);
+    // maxImageCount 0 means no limit
+        if (surfaceCap.maxImageCount != 0) {
+            cnt = std::min(cnt, surfaceCap.maxImageCount);
+        }
+        return cnt;
+    }
+    inline VkExtent2D querySwapchainExtent ()
+    {
+        vkGetPhysicalDeviceSurfaceCapabilitiesKHR(selectedPhysicalDevice, surface, &surfaceCap);
+    // 0xFFFFFFFF means the surface size is determined by the swapchain extent
+        if (surfaceCap.currentExtent.width != std::numeric_limits<uint32_t>::max()) {
+            return surfaceCap.currentExtent;
+        }
+        return VkExtent2D {
+            .width = std::clamp(windowExtent.width, surfaceCap.minImageExtent.width, surfaceCap.maxImageExtent.width),
+            .height = std::clamp(windowExtent.height, surfaceCap.minImageExtent.height, surfaceCap.maxImageExtent.height)
+        };
+    }
     inline void createSwapchain ()
     {
         VkSwapchainCreateInfoKHR swapchainCreateInfo;
+        VkSwapchainKHR oldSwapchain = swapchain;
         selectFormat();
-        vkGetPhysicalDeviceSurfaceCapabilitiesKHR(selectedPhysicalDevice, surface, &surfaceCap);
+        selectPresentMode();
+        swapchainExtent = querySwapchainExtent();
 
         auto& ci = swapchainCreateInfo;
         ci.sType = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR;
         ci.pNext = nullptr;
         ci.flags = 0;
         ci.surface = surface;
-        ci.minImageCount = std::max(surfaceCap.minImageCount, 2u);
+        ci.minImageCount = selectImageCount();
         ci.imageFormat = selectedSurfaceFormat.format;
         ci.imageColorSpace = selectedSurfaceFormat.colorSpace;
-        ci.imageExtent = surfaceCap.currentExtent;
+        ci.imageExtent = swapchainExtent;
     // non-stereoscopic-3D applications
         ci.imageArrayLayers = 1;
     // what you may use the swapchain as
         ci.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT;
-    // which queue family first use the swapchain get the ownership
-        //ci.imageSharingMode = VK_SHARING_MODE_EXCLUSIVE;
-        ci.imageSharingMode = VK_SHARING_MODE_CONCURRENT;
-        ci.queueFamilyIndexCount = queueFamilyInUse.size();
-        ci.pQueueFamilyIndices = queueFamilyInUse.data();
+    // swapchain images are only touched by the graphics queue (which also presents)
+        ci.imageSharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        ci.queueFamilyIndexCount = 0;
+        ci.pQueueFamilyIndices = nullptr;
     // transforms like rotate, flip, etc
         ci.preTransform = surfaceCap.currentTransform;
     // to be controlled by windowing system, use VK_COMPOSITE_ALPHA_INHERIT_BIT_KHR
         ci.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR;
     // "present" means the process that the image passed after renderred
-        ci.presentMode = VK_PRESENT_MODE_FIFO_KHR;
+        ci.presentMode = selectedPresentMode;
     // are pixels removed because not seen or some other reasons
         ci.clipped = VK_TRUE;
-        ci.oldSwapchain = VK_NULL_HANDLE;
+    // hand over the retired swapchain so the presentation engine can reuse its resources
+        ci.oldSwapchain = oldSwapchain;
         VkResult r = vkCreateSwapchainKHR(device, &ci, nullptr, &swapchain);
-        if (r != VK_SUCCESS) throw std::runtime_error(std::format("vkCreateSwapchainKHR: ", (int)r));
+        if (r != VK_SUCCESS) throw std::runtime_error(std::format("vkCreateSwapchainKHR: {}", (int)r));
+        if (oldSwapchain != VK_NULL_HANDLE) {
+            vkDestroySwapchainKHR(device, oldSwapchain, nullptr);
+        }
     }
 /*
     inline void prepVertexBufferCreateInfo (size_t bufferSize)
@@ -238,15 +552,71 @@ private:
         vbci.pQueueFamilyIndices = queueFamilyInUse.data();
     }
 */
-    inline void createSwapchainImageView ()
+    inline void getSwapchainImages ()
     {
-        std::vector<VkImageViewCreateInfo> swapchainImageViewCreateInfos;
-        {
-            uint32_t swapchainImageCnt = 0;
-            vkGetSwapchainImagesKHR(device, swapchain, &swapchainImageCnt, nullptr);
-            swapchainImages.resize(swapchainImageCnt);
-            vkGetSwapchainImagesKHR(device, swapchain, &swapchainImageCnt, swapchainImages.data());
+        uint32_t swapchainImageCnt = 0;
+        vkGetSwapchainImagesKHR(device, swapchain, &swapchainImageCnt, nullptr);
+        swapchainImages.resize(swapchainImageCnt);
+        vkGetSwapchainImagesKHR(device, swapchain, &swapchainImageCnt, swapchainImages.data());
+    }
+// Headless: device-local images stand in for swapchain images
+    inline void selectOffscreenFormat ()
+    {
+        for (VkFormat format : {VK_FORMAT_B8G8R8A8_SRGB, VK_FORMAT_R8G8B8A8_SRGB, VK_FORMAT_R8G8B8A8_UNORM}) {
+            VkFormatProperties props;
+            vkGetPhysicalDeviceFormatProperties(selectedPhysicalDevice, format, &props);
+            if (props.optimalTilingFeatures & VK_FORMAT_FEATURE_COLOR_ATTACHMENT_BIT) {
+                selectedSurfaceFormat.format = format;
+                selectedSurfaceFormat.colorSpace = VK_COLOR_SPACE_SRGB_NONLINEAR_KHR;
+                return;
+            }
+        }
+        throw std::runtime_error("no compatible offscreen pixel format supported");
+    }
+    inline void createOffscreenImages ()
+    {
+        selectOffscreenFormat();
+    // configured size until resize() asks for another one
+        if (windowExtent.width == 0 || windowExtent.height == 0) {
+            windowExtent = VkExtent2D {
+                .width = static_cast<uint32_t>(cfg.windowWidth),
+                .height = static_cast<uint32_t>(cfg.windowHeight)
+            };
+        }
+        swapchainExtent = windowExtent;
+        uint32_t imageCnt = cfg.swapchainImageCount != 0 ? cfg.swapchainImageCount : cfg.framesInFlight;
+        swapchainImages.resize(imageCnt);
+        offscreenImageAllocations.resize(imageCnt);
+        for (uint32_t i = 0; i < imageCnt; ++i) {
+            VkImageCreateInfo imageCreateInfo;
+            auto& ci = imageCreateInfo;
+            ci.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
+            ci.pNext = nullptr;
+            ci.flags = 0;
+            ci.imageType = VK_IMAGE_TYPE_2D;
+            ci.format = selectedSurfaceFormat.format;
+            ci.extent = VkExtent3D {
+                .width = swapchainExtent.width,
+                .height = swapchainExtent.height,
+                .depth = 1
+            };
+            ci.mipLevels = 1;
+            ci.arrayLayers = 1;
+            ci.samples = VK_SAMPLE_COUNT_1_BIT;
+            ci.tiling = VK_IMAGE_TILING_OPTIMAL;
+        // transfer src so frames can be read back
+            ci.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT;
+            ci.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+            ci.queueFamilyIndexCount = 0;
+            ci.pQueueFamilyIndices = nullptr;
+            ci.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+            swapchainImages[i] = allocator.createImage(ci, MemoryUsage::GpuOnly, offscreenImageAllocations[i]);
         }
+    }
+    inline void createSwapchainImageView ()
+    {
+        ScratchArena::Scope scope(scratch);
+        ScratchVector<VkImageViewCreateInfo> swapchainImageViewCreateInfos(scratch, swapchainImages.size());
         swapchainImageViewCreateInfos.resize(swapchainImages.size());
         swapchainImageViews.resize(swapchainImages.size());
         for (uint32_t i = 0; i < swapchainImages.size(); ++i) {
@@ -276,9 +646,10 @@ private:
     }
     inline void createRenderPass ()
     {
-        std::vector<VkAttachmentReference> colorAttachmentReferences;
-        std::vector<VkSubpassDescription> subpasses;
-        std::vector<VkSubpassDependency> dependencies;
+        ScratchArena::Scope scope(scratch);
+        ScratchVector<VkAttachmentReference> colorAttachmentReferences(scratch, 1);
+        ScratchVector<VkSubpassDescription> subpasses(scratch, 1);
+        ScratchVector<VkSubpassDependency> dependencies(scratch, 1);
         VkRenderPassCreateInfo renderPassCreateInfo;
     // Step 1: Prepare attachments info
         {
@@ -294,7 +665,7 @@ private:
             dsc.stencilStoreOp = VK_ATTACHMENT_STORE_OP_DONT_CARE;
         // for automatic layout transform (e.g. if input attachment layout != initialLayout then trans it)
             dsc.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED;
-            dsc.finalLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
+            dsc.finalLayout = cfg.headless ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR;
             colorAttachmentReferences.resize(1);
             for (uint32_t i = 0; i < colorAttachmentReferences.size(); ++i) {
                 auto& ref = colorAttachmentReferences[i];
@@ -345,7 +716,8 @@ private:
         VkResult r = vkCreateRenderPass(device, &renderPassCreateInfo, nullptr, &renderPass);
         if (r != VK_SUCCESS) throw std::runtime_error(std::format("vkCreateRenderPass: {}", (int)r));
     }
-    inline void readShaderCode (std::vector<char>& buffer, std::string rPath)
+// the returned code lives in scratch, within the caller's scope
+    inline ScratchVector<char> readShaderCode (std::string rPath)
     {
         std::string absPath = cfg.rootDir + std::string("/") + cfg.spirvPath + std::string("/") + rPath;
         std::ifstream file(absPath, std::ios::binary | std::ios::ate);
@@ -354,28 +726,28 @@ private:
         }
         std::streamsize fileSize = file.tellg();
         file.seekg(0, std::ios::beg);
+        ScratchVector<char> buffer(scratch, fileSize);
         buffer.resize(fileSize);
         if (!file.read(buffer.data(), fileSize)) {
             throw std::runtime_error("failed to read spirv file: " + absPath);
         }
         file.close();
+        return buffer;
     }
     inline void createShaderModule ()
     {
-        std::vector<std::vector<char>> shaderCodes;
-        std::vector<VkShaderModuleCreateInfo> shaderModuleCreateInfos;
-        shaderCodes.resize(2);
-        readShaderCode(shaderCodes[0], "triangle.vert");
-        readShaderCode(shaderCodes[1], "triangle.frag");
-        shaderModuleCreateInfos.resize(shaderCodes.size());
-        shaderModules.resize(shaderCodes.size());
-        for (uint32_t i = 0; i < shaderModuleCreateInfos.size(); ++i) {
-            auto& ci = shaderModuleCreateInfos[i];
+        ScratchArena::Scope scope(scratch);
+        std::array<const char*, 2> shaderNames = { "triangle.vert", bindless.enabled() ? "triangle.bindless.frag" : "triangle.frag" };
+        shaderModules.resize(shaderNames.size());
+        for (uint32_t i = 0; i < shaderNames.size(); ++i) {
+            ScratchVector<char> code = readShaderCode(shaderNames[i]);
+            VkShaderModuleCreateInfo shaderModuleCreateInfo;
+            auto& ci = shaderModuleCreateInfo;
             ci.sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO;
             ci.pNext = nullptr;
             ci.flags = 0;
-            ci.codeSize = shaderCodes[i].size();
-            ci.pCode = reinterpret_cast<const uint32_t*>(shaderCodes[i].data());
+            ci.codeSize = code.size();
+            ci.pCode = reinterpret_cast<const uint32_t*>(code.data());
             VkResult r = vkCreateShaderModule(device, &ci, nullptr, &(shaderModules[i]));
             if (r != VK_SUCCESS) throw std::runtime_error(std::format("vkCreateShaderModule: {}", (int)r));
         }
@@ -387,10 +759,18 @@ private:
         ci.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
         ci.pNext = nullptr;
         ci.flags = 0;
-        ci.vertexBindingDescriptionCount = 0;
-        ci.pVertexBindingDescriptions = nullptr;
-        ci.vertexAttributeDescriptionCount = 0;
-        ci.pVertexAttributeDescriptions = nullptr;
+    // one interleaved binding, see Vertex
+        vertexBindingDescriptions = {
+            VkVertexInputBindingDescription { 0, sizeof(Vertex), VK_VERTEX_INPUT_RATE_VERTEX }
+        };
+        vertexAttributeDescriptions = {
+            VkVertexInputAttributeDescription { 0, 0, VK_FORMAT_R32G32_SFLOAT, offsetof(Vertex, position) },
+            VkVertexInputAttributeDescription { 1, 0, VK_FORMAT_R32G32B32_SFLOAT, offsetof(Vertex, color) }
+        };
+        ci.vertexBindingDescriptionCount = vertexBindingDescriptions.size();
+        ci.pVertexBindingDescriptions = vertexBindingDescriptions.data();
+        ci.vertexAttributeDescriptionCount = vertexAttributeDescriptions.size();
+        ci.pVertexAttributeDescriptions = vertexAttributeDescriptions.data();
     }
     inline void prepInputAssemblyStateCreateInfo ()
     {
@@ -413,33 +793,15 @@ private:
     }
     inline void prepViewportStateCreateInfo ()
     {
-        {
-            viewports.resize(1);
-            auto& v = viewports[0];
-            v.x = 0.8f;
-            v.y = 0.8f;
-            v.width = surfaceCap.currentExtent.width;
-            v.height = surfaceCap.currentExtent.height;
-            v.minDepth = 0.0f;
-            v.maxDepth = 1.0f;
-        }
-        {
-            scissors.resize(1);
-            VkRect2D& s = scissors[0];
-            s.offset = VkOffset2D {
-                .x = 0u,
-                .y = 0u
-            };
-            s.extent = surfaceCap.currentExtent;
-        }
+    // counts only, both are dynamic states
         auto& ci = pipelineStateCreateInfos.viewport;
         ci.sType = VK_STRUCTURE_TYPE_PIPELINE_VIEWPORT_STATE_CREATE_INFO;
         ci.pNext = nullptr;
         ci.flags = 0;
-        ci.viewportCount = viewports.size();
-        ci.pViewports = viewports.data();
-        ci.scissorCount = scissors.size();
-        ci.pScissors = scissors.data();
+        ci.viewportCount = 1;
+        ci.pViewports = nullptr;
+        ci.scissorCount = 1;
+        ci.pScissors = nullptr;
     }
     inline void prepRasterizationStateCreateInfo ()
     {
@@ -531,25 +893,7 @@ private:
 
     inline void createGraphicsPipeline ()
     {
-        VkGraphicsPipelineCreateInfo graphicsPipelineCreateInfo;
-    // Step 1: Prepare shader stages info
-        std::vector<VkPipelineShaderStageCreateInfo> shaderStageCreateInfos;
-        shaderStageCreateInfos.resize(shaderModules.size());
-        for (uint32_t i = 0; i < shaderStageCreateInfos.size(); ++i) {
-            auto& ci = shaderStageCreateInfos[i];
-            ci.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
-            ci.pNext = nullptr;
-            ci.flags = 0;
-            switch (i) {
-                case 0u: ci.stage = VK_SHADER_STAGE_VERTEX_BIT; break;
-                case 1u: ci.stage = VK_SHADER_STAGE_FRAGMENT_BIT; break;
-                default: throw std::runtime_error("not implemented path");
-            }
-            ci.module = shaderModules[i];
-            ci.pName = "main";
-            ci.pSpecializationInfo = nullptr;
-        }
-    // Step 2: Prepare states info
+    // Step 1: Prepare states info
         prepVertexInputStateCreateInfo();
         prepInputAssemblyStateCreateInfo();
         // prepTessellationStateCreateInfo();
@@ -559,8 +903,15 @@ private:
         // prepDepthStencilStateCreateInfo();
         prepColorBlendStateCreateInfo();
         prepDynamicStateCreateInfo();
-    // Step 3: Prepare descriptor set layout (not implemented yet)
-    // Step 4: Create pipeline layout
+    // Step 2: Prepare descriptor set layout, set 0 is the frame arena
+        descriptorSetLayout = { frameArena.setLayout() };
+        if (bindless.enabled()) {
+            descriptorSetLayout.push_back(bindless.setLayout());
+        }
+        pushConstantRanges = {
+            VkPushConstantRange { VK_SHADER_STAGE_VERTEX_BIT | VK_SHADER_STAGE_FRAGMENT_BIT, 0, sizeof(BindlessTable::Handles) }
+        };
+    // Step 3: Create pipeline layout
         {
             auto& ci = pipelineLayoutCreateInfo;
             ci.sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO;
@@ -572,6 +923,34 @@ private:
             ci.pPushConstantRanges = pushConstantRanges.data();VkResult r = vkCreatePipelineLayout(device, &pipelineLayoutCreateInfo, nullptr, &pipelineLayout);
             if (r != VK_SUCCESS) throw std::runtime_error(std::format("vkCreatePipelineLayout: {}", (int)r));
         }
+    // Step 4: Register the variants, compiled by buildGraphicsPipeline
+        addTrianglePipelines();
+    }
+// Registers every triangle variant; the states live in pipelineStateCreateInfos and the
+// layout / render pass / shader modules come from createGraphicsPipeline. Registering
+// again returns the pipelines already there.
+    inline void addTrianglePipelines ()
+    {
+        VkGraphicsPipelineCreateInfo graphicsPipelineCreateInfo;
+    // Step 1: Prepare shader stages info
+        ScratchArena::Scope scope(scratch);
+        ScratchVector<VkPipelineShaderStageCreateInfo> shaderStageCreateInfos(scratch, shaderModules.size());
+        shaderStageCreateInfos.resize(shaderModules.size());
+        for (uint32_t i = 0; i < shaderStageCreateInfos.size(); ++i) {
+            auto& ci = shaderStageCreateInfos[i];
+            ci.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO;
+            ci.pNext = nullptr;
+            ci.flags = 0;
+            switch (i) {
+                case 0u: ci.stage = VK_SHADER_STAGE_VERTEX_BIT; break;
+                case 1u: ci.stage = VK_SHADER_STAGE_FRAGMENT_BIT; break;
+                default: throw std::runtime_error("not implemented path");
+            }
+            ci.module = shaderModules[i];
+            ci.pName = "main";
+            ci.pSpecializationInfo = nullptr;
+        }
+    // Step 2: Prepare the create info
         auto& ci = graphicsPipelineCreateInfo;
         ci.sType = VK_STRUCTURE_TYPE_GRAPHICS_PIPELINE_CREATE_INFO;
         ci.pNext = nullptr;
@@ -594,12 +973,66 @@ private:
         ci.subpass = 0;
         ci.basePipelineHandle = VK_NULL_HANDLE;
         ci.basePipelineIndex = 0;
-        VkResult r = vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &graphicsPipelineCreateInfo, nullptr, &pipeline);
-        if (r != VK_SUCCESS) throw std::runtime_error(std::format("vkCreateGraphicsPipelines: {}", (int)r));
+    // Step 3: Register one pipeline per combination of the constants
+        for (uint32_t variant = 0; variant < trianglePipelines.size(); ++variant) {
+            std::array<uint32_t, TriangleConstantCount> constants;
+            for (uint32_t c = 0; c < TriangleConstantCount; ++c) {
+                constants[c] = (variant >> c) & 1u ? VK_TRUE : VK_FALSE;
+            }
+            trianglePipelines[variant] = pipelines.add("triangle", graphicsPipelineCreateInfo, constants);
+        }
+    }
+    inline void setTriangleVariant (uint32_t variant)
+    {
+        if (variant == triangleVariant) return;
+        triangleVariant = variant;
+    // picked up by the next frame; cached bucket secondaries bind the pipeline, so they go stale
+        pipeline = VK_NULL_HANDLE;
+        ++pipelineGeneration;
+    }
+    inline void createVertexBuffer ()
+    {
+        const std::array<Vertex, 3> vertices = {{
+            { { 0.0f, -0.5f }, { 1.0f, 0.0f, 0.0f } },
+            { { 0.5f, 0.5f }, { 0.0f, 1.0f, 0.0f } },
+            { { -0.5f, 0.5f }, { 0.0f, 0.0f, 1.0f } }
+        }};
+        VkBufferCreateInfo bufferCreateInfo;
+        auto& ci = bufferCreateInfo;
+        ci.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+        ci.pNext = nullptr;
+        ci.flags = 0;
+        ci.size = sizeof(vertices);
+        ci.usage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT;
+        ci.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        ci.queueFamilyIndexCount = 0;
+        ci.pQueueFamilyIndices = nullptr;
+        vertexBuffer = allocator.createBuffer(ci, MemoryUsage::GpuOnly, vertexAllocation);
+        std::vector<char> data(sizeof(vertices));
+        std::memcpy(data.data(), vertices.data(), sizeof(vertices));
+        vertexTicket = uploader.uploadBuffer(vertexBuffer, 0, std::move(data));
+    }
+    inline void createMaterialBuffer ()
+    {
+        const std::array<float, 4> material = { 1.0f, 1.0f, 1.0f, 1.0f };
+        VkBufferCreateInfo bufferCreateInfo;
+        auto& ci = bufferCreateInfo;
+        ci.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+        ci.pNext = nullptr;
+        ci.flags = 0;
+        ci.size = sizeof(material);
+        ci.usage = VK_BUFFER_USAGE_STORAGE_BUFFER_BIT;
+        ci.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+        ci.queueFamilyIndexCount = 0;
+        ci.pQueueFamilyIndices = nullptr;
+        materialBuffer = allocator.createBuffer(ci, MemoryUsage::Dynamic, materialAllocation);
+        std::memcpy(materialAllocation.mapped, material.data(), sizeof(material));
+        drawHandles.buffer = bindless.addBuffer(materialBuffer, 0, sizeof(material));
     }
     inline void createFramebuffer ()
     {
-        std::vector<VkFramebufferCreateInfo> framebufferCreateInfos;
+        ScratchArena::Scope scope(scratch);
+        ScratchVector<VkFramebufferCreateInfo> framebufferCreateInfos(scratch, swapchainImageViews.size());
         framebufferCreateInfos.resize(swapchainImageViews.size());
         framebuffers.resize(swapchainImageViews.size());
         for (uint32_t i = 0; i < framebufferCreateInfos.size(); ++i) {
@@ -611,17 +1044,35 @@ private:
             ci.attachmentCount = 1;
             ci.pAttachments = &(swapchainImageViews[i]);
         // three dimensions of the framebuffer
-            ci.width = surfaceCap.currentExtent.width;
-            ci.height = surfaceCap.currentExtent.height;
+            ci.width = swapchainExtent.width;
+            ci.height = swapchainExtent.height;
             ci.layers = 1;
             VkResult r = vkCreateFramebuffer(device, &ci, nullptr, &(framebuffers[i]));
             if (r != VK_SUCCESS) throw std::runtime_error(std::format("vkCreateFramebuffer: {}", (int)r));
         }
     }
 
+    template <typename F>
+    inline void timedPhase (const char* name, F&& f)
+    {
+        auto t = Telemetry::now();
+        f();
+        initPhases.emplace_back(name, Telemetry::since(t));
+    }
+
+    void updateSimulation ();
     void buildCommandBuffer ();
+    void recordCommandBuffer (VkCommandBuffer cb, uint32_t imageIdx);
+    void recordDraws (VkCommandBuffer cb, size_t first, size_t cnt);
+    void recordSecondaryCommandBuffers (uint32_t imageIdx);
+    void recordBuckets ();
+    void buildImageSyncs ();
     void buildGraphicsPipeline ();
     void buildSwapchain ();
+    void buildOffscreenTargets ();
+    void destroySwapchainResources ();
+    void destroyOffscreenImages ();
+    void rebuildSwapchain ();
 
 public:
     Vulkan (std::vector<const char*> additionalInstanceExtensions, Config& cfg);
@@ -631,6 +1082,92 @@ public:
 
     void render ();
     
+// Replace one bucket's draws, from the render thread between frames.
+// In cached mode only buckets whose content actually changed get re-recorded.
+    void setBucketDraws (RenderBucket bucket, const std::vector<DrawCmd>& draws);
+// called with the drawable size of the window, the swapchain follows before the next frame
+    inline void resize (uint32_t width, uint32_t height)
+    {
+        windowExtent = VkExtent2D { .width = width, .height = height };
+        if (swapchain != VK_NULL_HANDLE || !swapchainImages.empty()) {
+            swapchainDirty = true;
+        }
+    }
+    inline VkExtent2D getExtent () const
+    {
+        return swapchainExtent;
+    }
+    inline const PipelineRegistry& getPipelines () const
+    {
+        return pipelines;
+    }
+// Registers all pipelines again and compiles what is new, which is nothing once
+// buildGraphicsPipeline has run (pipelines are keyed by name and constants)
+    inline void registerPipelines ()
+    {
+        addTrianglePipelines();
+        pipelines.compile();
+    }
+// Flip a specialization constant of the triangle, render thread between frames;
+// every variant is compiled at init, so this never compiles
+    inline void toggleRotate ()
+    {
+        setTriangleVariant(triangleVariant ^ (1u << Rotate));
+    }
+    inline void toggleHueTint ()
+    {
+        setTriangleVariant(triangleVariant ^ (1u << HueTint));
+    }
+    inline VkPipeline getPipeline () const
+    {
+        return pipeline;
+    }
+
+// next frame starts a new frame interval (after idling, the gap is not a frame time)
+    inline void resetFrameTiming ()
+    {
+        lastFrameStartTime = Telemetry::Clock::time_point();
+    }
+
+    inline Uploader& getUploader ()
+    {
+        return uploader;
+    }
+// Copies size bytes of src back to the host, blocking (waits for the device to idle first).
+// For checks and tools, never per frame. src needs TRANSFER_SRC and must be owned by graphics.
+    std::vector<char> readBuffer (VkBuffer src, VkDeviceSize size);
+
+// register textures / buffers, hand the handles to shaders via push constants
+    inline BindlessTable& getBindless ()
+    {
+        return bindless;
+    }
+// e.g. to register eviction callbacks of resource caches
+    inline GpuAllocator& getAllocator ()
+    {
+        return allocator;
+    }
+
+    inline Telemetry& getTelemetry ()
+    {
+        return telemetry;
+    }
+
+// Blocks until every registered pipeline is compiled; the time not hidden behind
+// the rest of init is recorded as init phase "pipelineCompile"
+    inline void waitPipelines ()
+    {
+        timedPhase("pipelineCompile", [this] { pipelines.waitAll(); });
+    }
+    inline const std::vector<std::pair<std::string, uint64_t>>& getInitPhases ()
+    {
+        return initPhases;
+    }
+    inline std::string getDeviceName ()
+    {
+        return physicalDeviceProperties.deviceName;
+    }
+
     inline VkInstance& getInstance ()
     {
         return instance;
@@ -639,9 +1176,22 @@ public:
     inline void initGraphics (VkSurfaceKHR& s)
     {
         surface = s;
-        buildSwapchain();
-        buildGraphicsPipeline();
-        buildCommandBuffer();
+    // frames are presented from the graphics queue
+        VkBool32 presentSupported = VK_FALSE;
+        vkGetPhysicalDeviceSurfaceSupportKHR(selectedPhysicalDevice, graphicsQueue.family, surface, &presentSupported);
+        if (!presentSupported) {
+            throw std::runtime_error(std::format("queue family {} cannot present to the surface", graphicsQueue.family));
+        }
+        timedPhase("buildSwapchain", [this] { buildSwapchain(); });
+        timedPhase("buildGraphicsPipeline", [this] { buildGraphicsPipeline(); });
+        timedPhase("buildCommandBuffer", [this] { buildCommandBuffer(); });
+    }
+// no surface, no swapchain, no present: render into device-local images
+    inline void initHeadless ()
+    {
+        timedPhase("buildOffscreenTargets", [this] { buildOffscreenTargets(); });
+        timedPhase("buildGraphicsPipeline", [this] { buildGraphicsPipeline(); });
+        timedPhase("buildCommandBuffer", [this] { buildCommandBuffer(); });
     }
 };
 #endif
@@ -1,22 +1,95 @@
 #include "utils.h"
 #include "Vulkan.h"
 #include "Sdl.h"
+#include "Headless.h"
 #include "Config.h"
+#include "Bench.h"
+#include "ResizeCheck.h"
+#include "UploadCheck.h"
+#include "PipelineCheck.h"
 
 #include <iostream>
 #include <string>
 #include <array>
 #include <vector>
 #include <format>
+#include <chrono>
 
-int main () {
+// Ctx is Sdl (window + swapchain, dedicated render thread) or Headless (offscreen images)
+template <typename Ctx>
+void run (Config& cfg)
+{
+    Ctx ctx(cfg);
+    ctx.run();
+}
+
+// Usage: main [--bench] [--warmup N] [--frames N] [--scene NAME] [--out FILE] [--check-resize] [--check-upload] [--check-pipelines]
+// --scene also applies outside of --bench and overrides config.ini
+static void parseArgs (int argc, char** argv, Config& cfg, BenchOptions& bench, bool& checkResize, bool& checkUpload, bool& checkPipelines)
+{
+    for (int i = 1; i < argc; ++i) {
+        std::string arg = argv[i];
+        auto next = [&] () -> std::string {
+            if (i + 1 >= argc) throw std::runtime_error(std::format("missing value for {}", arg));
+            return argv[++i];
+        };
+        try {
+        if (arg == "--bench") {
+            bench.enabled = true;
+        } else if (arg == "--warmup") {
+            bench.warmupFrames = std::stoul(next());
+        } else if (arg == "--frames") {
+            bench.measuredFrames = std::stoul(next());
+        } else if (arg == "--scene") {
+            cfg.scene = next();
+        } else if (arg == "--out") {
+            bench.outPath = next();
+        } else if (arg == "--check-resize") {
+            checkResize = true;
+        } else if (arg == "--check-upload") {
+            checkUpload = true;
+        } else if (arg == "--check-pipelines") {
+            checkPipelines = true;
+        } else {
+            throw std::runtime_error(std::format("unknown argument {}", arg));
+        }
+        } catch (std::exception& e) {
+            throw std::runtime_error(std::format("parsing arguments failed: {}", e.what()));
+        }
+    }
+// headless runs stop by themselves, let them cover the whole bench
+    if (bench.enabled) {
+        cfg.headlessFrames = bench.warmupFrames + bench.measuredFrames;
+    }
+}
+
+int main (int argc, char** argv) {
+    auto processStartTime = std::chrono::steady_clock::now();
 try {
     Config cfg("config.ini");
-    Sdl sdlCtx(cfg);
-
-    while (sdlCtx.running) {
-        sdlCtx.eventLoop();
-        sdlCtx.render();
+    BenchOptions bench;
+    bool checkResize = false, checkUpload = false, checkPipelines = false;
+    parseArgs(argc, argv, cfg, bench, checkResize, checkUpload, checkPipelines);
+    if (checkResize || checkUpload || checkPipelines) {
+        if (checkResize) {
+            runResizeCheck(cfg);
+        }
+        if (checkUpload) {
+            runUploadCheck(cfg);
+        }
+        if (checkPipelines) {
+            runPipelineCheck(cfg);
+        }
+    } else if (bench.enabled) {
+        if (cfg.headless) {
+            runBench<Headless>(cfg, bench, processStartTime);
+        } else {
+            runBench<Sdl>(cfg, bench, processStartTime);
+        }
+    } else if (cfg.headless) {
+        run<Headless>(cfg);
+    } else {
+        run<Sdl>(cfg);
     }
 
 } catch (std::runtime_error e) {
@@ -4,7 +4,8 @@
 #include <iostream>
 #include <string>
 
+// stderr like warnings and errors, stdout is left to program output (bench JSON)
 inline void logInfo (std::string msg) {
-    std::cout << "[INFO] " << msg << std::endl;
+    std::cerr << "[INFO] " << msg << std::endl;
 }
 #endif